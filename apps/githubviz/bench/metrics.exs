@@ -0,0 +1,35 @@
+# Measures the cost of recording metrics on hot paths.
+#
+# Run with `mix run bench/metrics.exs` from `apps/githubviz`.
+
+alias GithubViz.Metrics, as: M
+
+iterations = 1_000_000
+processes = System.schedulers_online()
+
+measure = fn (fun) ->
+  # Warm up, so we don't measure registration.
+  fun.()
+
+  {baseline, _} = :timer.tc(fn -> Enum.each(1..iterations, fn _ -> :ok end) end)
+  {elapsed, _} = :timer.tc(fn -> Enum.each(1..iterations, fn _ -> fun.() end) end)
+
+  (elapsed - baseline) * 1_000 / iterations
+end
+
+measure_concurrently = fn (fun) ->
+  1..processes
+  |> Enum.map(fn _ -> Task.async(fn -> measure.(fun) end) end)
+  |> Enum.map(&Task.await(&1, :infinity))
+  |> Enum.sum
+  |> Kernel./(processes)
+end
+
+report = fn (name, ns) ->
+  IO.puts String.pad_trailing(name, 40) <> "#{Float.round(ns, 1)}ns/op"
+end
+
+report.("count/2", measure.(fn -> M.count("bench.counter", 1) end))
+report.("sample/2", measure.(fn -> M.sample("bench.gauge", 12_345) end))
+report.("count/2 (#{processes} processes)", measure_concurrently.(fn -> M.count("bench.counter", 1) end))
+report.("sample/2 (#{processes} processes)", measure_concurrently.(fn -> M.sample("bench.gauge", 12_345) end))
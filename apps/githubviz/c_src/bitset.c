@@ -1,6 +1,9 @@
 /* TODO(mtwilliams): Rather use `getconf LFS_CFLAGS`? */
 #define _FILE_OFFSET_BITS 64
 
+/* For open file description locks. See `bitset_lock`. */
+#define _GNU_SOURCE
+
 #include <assert.h>
 #include <stdlib.h>
 #include <stdbool.h>
@@ -23,7 +26,7 @@
 #  define TRUE (true)
 #endif
 #ifndef FALSE
-#  define FALSE (true)
+#  define FALSE (false)
 #endif
 
 /*
@@ -32,7 +35,7 @@
 
 /* Quickly computes the base-2 logarithim of |n|. */
 static uint64_t u_log2i(uint64_t n) {
-  return n ? (64 - __builtin_clzll(n - 1)) : 0;
+  return (n > 1) ? (64 - __builtin_clzll(n - 1)) : 0;
 }
 
 /* Returns the number of bytes required to hold |n| bits. */
@@ -54,6 +57,11 @@ static uint64_t u_highest_in_array(const uint64_t *array, const uint64_t n) {
   return highest;
 }
 
+/* Reverses the order of bits in |byte|. */
+static uint8_t u_reverse_byte(const uint8_t byte) {
+  return (uint8_t)((((byte * 0x80200802ull) & 0x0884422110ull) * 0x0101010101ull) >> 32);
+}
+
 /* OPTIMIZE(mtwilliams): Do we want to relax ordering? */
 
 static uint64_t atomic_load_64(volatile uint64_t *P) {
@@ -90,15 +98,27 @@ static void atomic_decrement_64(volatile uint64_t *P) {
  * Interface
  */
 
-#define BITSET_VERSION ((uint64_t)1)
+#define BITSET_VERSION ((uint64_t)2)
+
+/* Most planes a bitset can have. Planes for an identifier are interleaved, so
+ * they must fit in (and evenly divide) a word. */
+#define BITSET_MAX_PLANES ((uint64_t)64)
 
 typedef struct bitset {
   /* Backing file. */
   char path[256];
   int fd;
 
-  /* Where we've mapped the backing file in memory. */
+  /* Whether or not we opened the backing file for writing. */
+  bool writable;
+
+  /* Where we've mapped the backing file in memory, and how many bytes. */
   volatile void *base;
+  volatile uint64_t mapped;
+
+  /* Number of bits per identifier, and its base-2 logarithim. */
+  uint64_t planes;
+  uint64_t planes_log2;
 
   /* Lock-free tracking of operations.
    * See `bitset_wait_for_operations_in_progress`. */
@@ -113,8 +133,15 @@ typedef struct bitset {
 } bitset_t;
 
 typedef struct bitset_options {
-  /* Minimum size of bitset in number of bits. */
+  /* Minimum size of bitset in number of identifiers. */
   uint64_t size;
+
+  /* Number of bits per identifier. Must be a power of two no greater than
+   * `BITSET_MAX_PLANES`. Zero means whatever an existing bitset has, or one. */
+  uint64_t planes;
+
+  /* Open an existing bitset for reading only, alongside its writer. */
+  bool read_only;
 } bitset_options_t;
 
 /* TODO(mtwilliams): Rename to something clearer. */
@@ -128,6 +155,11 @@ typedef struct bitset_meta_t {
   /* Size of bitset in number of bits. */
   uint64_t size;
 
+  /* Number of bits per identifier. Every plane of an identifier is stored
+   * next to the others, i.e. plane |p| of identifier |i| is bit |i*planes+p|,
+   * so they always share a word and thus a cache line. */
+  uint64_t planes;
+
   uint64_t bits[0];
 } bitset_meta_t;
 
@@ -144,6 +176,10 @@ typedef enum bitset_error {
   BITSET_ERROR_OUT_OF_MEMORY = 4,
   /* Out of storage. */
   BITSET_ERROR_OUT_OF_STORAGE = 5,
+  /* No such bitset. */
+  BITSET_ERROR_NOT_FOUND = 6,
+  /* Already open for writing elsewhere. */
+  BITSET_ERROR_LOCKED = 7,
   BITSET_ERROR_UNKNOWN = -1
 } bitset_error_t;
 
@@ -154,8 +190,13 @@ typedef enum bitset_error {
 /* */
 static bitset_error_t bitset_open(const char *path, const bitset_options_t *options, bitset_t **bitset);
 
-/* */
-static void bitset_close(bitset_t *bitset, bool del);
+/* Unmaps |bitset| and releases its backing file, deleting it if |del|. Waits
+ * for changes to hit the backing file if |sync|, otherwise leaves them to the
+ * kernel. Doesn't free |bitset|, see `bitset_free`. */
+static void bitset_close(bitset_t *bitset, bool del, bool sync);
+
+/* Frees a closed |bitset|. */
+static void bitset_free(bitset_t *bitset);
 
 /* Returns the number of bytes required to store a bitset on disk that can hold
  * |num_of_bits| bits. */
@@ -169,9 +210,26 @@ static uint64_t bitset_size_in_memory(uint64_t num_of_bits) {
   return bitset_size_on_disk(num_of_bits);
 }
 
+/* Returns the bit that holds |plane| of |id|. */
+static uint64_t bitset_bit(const bitset_t *bitset, const uint64_t id, const uint64_t plane) {
+  assert(plane < bitset->planes);
+  return (id << bitset->planes_log2) | plane;
+}
+
 static bitset_error_t bitset_get(bitset_t *bitset, const uint64_t *bits, uint64_t *states, const uint64_t n);
 static bitset_error_t bitset_set(bitset_t *bitset, const uint64_t *bits, const uint64_t n);
 
+/* Sets every bit in |bits|, returning their previous |states|. */
+static bitset_error_t bitset_test_and_set(bitset_t *bitset, const uint64_t *bits, uint64_t *states, const uint64_t n);
+
+/* Sets or unsets every bit from |first| to |last| inclusive. */
+static bitset_error_t bitset_fill_range(bitset_t *bitset, const uint64_t first, const uint64_t last, const bool state);
+
+/* Gets the state of every bit from |first| to |last| inclusive, packing them
+ * most significant bit first into |packed|, which must have room for
+ * |last-first+1| bits rounded up to a whole byte. */
+static bitset_error_t bitset_get_range(bitset_t *bitset, const uint64_t first, const uint64_t last, uint8_t *packed);
+
 /* Grows or shrinks |bitset| to hold |bits| bits.*/
 static bitset_error_t bitset_resize(bitset_t *bitset, const uint64_t bits);
 
@@ -198,8 +256,55 @@ static bitset_error_t bitset_grow_if_nessecary(bitset_t *bitset, const uint64_t
 /* Waits until all operations currently in progress complete. */
 static void bitset_wait_for_operations_in_progress(bitset_t *bitset);
 
+/* Remaps a read-only |bitset| if its writer has grown it. */
+static bitset_error_t bitset_refresh(bitset_t *bitset);
+
+/* Writers hold a write lock on the first byte of the backing file, so there's
+ * only ever one. Readers hold a read lock on the second, so they don't
+ * conflict with the writer but it can tell if anyone has the file mapped.
+ *
+ * We can't use `flock` as it can't express that, so we use open file
+ * description locks where available. Elsewhere we fall back to process
+ * associated locks, which don't conflict within a process and are all
+ * released when any descriptor for the file is closed. */
+#ifdef F_OFD_SETLK
+#  define BITSET_SETLK F_OFD_SETLK
+#  define BITSET_GETLK F_OFD_GETLK
+#else
+#  define BITSET_SETLK F_SETLK
+#  define BITSET_GETLK F_GETLK
+#endif
+
+#define BITSET_LOCK_WRITER  ((off_t)0)
+#define BITSET_LOCK_READERS ((off_t)1)
+
+/* Tries to acquire a lock of |type| on |which|. Doesn't block. */
+static bool bitset_lock(int fd, short type, off_t which) {
+  struct flock lock;
+  memset((void *)&lock, 0, sizeof(lock));
+  lock.l_type = type;
+  lock.l_whence = SEEK_SET;
+  lock.l_start = which;
+  lock.l_len = 1;
+  return (fcntl(fd, BITSET_SETLK, &lock) == 0);
+}
+
+/* Returns true if anyone may have the bitset backed by |fd| open for reading. */
+static bool bitset_has_readers(int fd) {
+  struct flock lock;
+  memset((void *)&lock, 0, sizeof(lock));
+  lock.l_type = F_WRLCK;
+  lock.l_whence = SEEK_SET;
+  lock.l_start = BITSET_LOCK_READERS;
+  lock.l_len = 1;
+  if (fcntl(fd, BITSET_GETLK, &lock) != 0)
+    return true;
+  return (lock.l_type != F_UNLCK);
+}
+
 static bitset_error_t bitset_create(const char *path, int fd, const bitset_options_t *options, bitset_t **bitset) {
-  const uint64_t bits = (1 << (u_log2i(options->size) + 1));
+  const uint64_t planes = options->planes ? options->planes : 1;
+  const uint64_t bits = (1ull << (u_log2i(options->size * planes) + 1));
 
   const uint64_t size_on_disk = bitset_size_on_disk(bits);
   const uint64_t size_in_mem = bitset_size_in_memory(bits);
@@ -218,21 +323,29 @@ static bitset_error_t bitset_create(const char *path, int fd, const bitset_optio
   meta->magic[3] = 'S';
   meta->version = BITSET_VERSION;
   meta->size = bits;
+  meta->planes = planes;
 
   msync((void *)meta, sizeof(bitset_meta_t), MS_SYNC);
 
   *bitset = (bitset_t *)malloc(sizeof(bitset_t));
   strncpy(&(*bitset)->path[0], path, 256);
   (*bitset)->fd = fd;
+  (*bitset)->writable = true;
   (*bitset)->base = base;
+  (*bitset)->mapped = size_in_mem;
+  (*bitset)->planes = meta->planes;
+  (*bitset)->planes_log2 = u_log2i(meta->planes);
   (*bitset)->operations.started = 0;
   (*bitset)->operations.completed = 0;
   (*bitset)->locked = FALSE;
 
   return BITSET_ERROR_NONE;
 
-error:
+error: {
+  const int error = errno;
   close(fd);
+  errno = error;
+}
 
   if (errno == EACCES)
     return BITSET_ERROR_PERMISSIONS;
@@ -248,25 +361,54 @@ static bitset_error_t bitset_open(const char *path, const bitset_options_t *opti
   assert(path != NULL);
   assert(strlen(path) <= 255);
   assert(options != NULL);
+  assert(options->planes <= BITSET_MAX_PLANES);
+  assert((options->planes & (options->planes - 1)) == 0);
   assert(bitset != NULL);
 
-  /* TODO(mtwilliams): Acquire an exclusive lock on |fd|. */
-  int fd = open(path, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  const bool writable = !options->read_only;
+
+  int fd = writable ? open(path, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH)
+                    : open(path, O_RDONLY);
   if (fd == -1)
     goto error;
 
+  if (!bitset_lock(fd, writable ? F_WRLCK : F_RDLCK,
+                       writable ? BITSET_LOCK_WRITER : BITSET_LOCK_READERS)) {
+    const int error = errno;
+    close(fd);
+    if ((error == EAGAIN) || (error == EACCES))
+      return BITSET_ERROR_LOCKED;
+    return BITSET_ERROR_UNKNOWN;
+  }
+
   struct stat stat;
   if (fstat(fd, &stat) != 0) {
     close(fd);
     return BITSET_ERROR_UNKNOWN;
   }
 
-  if (stat.st_size == 0)
-    return bitset_create(path, fd, options, bitset);
+  if (stat.st_size == 0) {
+    if (writable)
+      return bitset_create(path, fd, options, bitset);
+    /* Our writer hasn't finished creating it yet. */
+    close(fd);
+    return BITSET_ERROR_NOT_A_BITSET;
+  }
 
-  void *base = mmap(NULL, stat.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-  if (base == MAP_FAILED)
+  if ((uint64_t)stat.st_size < sizeof(bitset_meta_t)) {
+    close(fd);
+    return BITSET_ERROR_NOT_A_BITSET;
+  }
+
+  const int prot = writable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+
+  void *base = mmap(NULL, stat.st_size, prot, MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED) {
+    const int error = errno;
+    close(fd);
+    errno = error;
     goto error;
+  }
 
   bitset_meta_t *meta = (bitset_meta_t *)base;
 
@@ -282,10 +424,21 @@ static bitset_error_t bitset_open(const char *path, const bitset_options_t *opti
     return BITSET_ERROR_UNSUPPORTED;
   }
 
+  if (options->planes && (meta->planes != options->planes)) {
+    /* We can't reinterleave an existing bitset. */
+    munmap(base, stat.st_size);
+    close(fd);
+    return BITSET_ERROR_UNSUPPORTED;
+  }
+
   *bitset = (bitset_t *)malloc(sizeof(bitset_t));
   strncpy(&(*bitset)->path[0], path, 256);
   (*bitset)->fd = fd;
+  (*bitset)->writable = writable;
   (*bitset)->base = base;
+  (*bitset)->mapped = stat.st_size;
+  (*bitset)->planes = meta->planes;
+  (*bitset)->planes_log2 = u_log2i(meta->planes);
   (*bitset)->operations.started = 0;
   (*bitset)->operations.completed = 0;
   (*bitset)->locked = FALSE;
@@ -293,6 +446,8 @@ static bitset_error_t bitset_open(const char *path, const bitset_options_t *opti
   return BITSET_ERROR_NONE;
 
 error:
+  if (errno == ENOENT)
+    return BITSET_ERROR_NOT_FOUND;
   if (errno == EACCES)
     return BITSET_ERROR_PERMISSIONS;
   if (errno == ENOMEM)
@@ -305,7 +460,7 @@ error:
   return BITSET_ERROR_UNKNOWN;
 }
 
-static void bitset_close(bitset_t *bitset, bool del) {
+static void bitset_close(bitset_t *bitset, bool del, bool sync) {
   assert(bitset != NULL);
 
   while (atomic_cmp_and_xchg_64(&bitset->locked, FALSE, TRUE) != FALSE);
@@ -313,29 +468,61 @@ static void bitset_close(bitset_t *bitset, bool del) {
   /* Wait until *all* operations are completed, so we don't lose data. */
   bitset_wait_for_operations_in_progress(bitset);
 
-  const uint64_t size_in_mem =
-    bitset_size_in_memory(((bitset_meta_t *)bitset->base)->size);
-
-  if (!del) {
+  if (bitset->writable && !del && sync) {
     /* Make sure all data hits our backing file. */
-    msync((void *)bitset->base, size_in_mem, MS_SYNC);
+    msync((void *)bitset->base, bitset->mapped, MS_SYNC);
   }
 
-  munmap((void *)bitset->base, size_in_mem);
-  close(bitset->fd);
+  munmap((void *)bitset->base, bitset->mapped);
 
-  if (del) {
+  /* Only writers get to delete. */
+  if (bitset->writable && del) {
     remove(bitset->path);
   }
 
+  /* Releases our lock. */
+  close(bitset->fd);
+}
+
+static void bitset_free(bitset_t *bitset) {
+  assert(bitset != NULL);
   free((void *)bitset);
 }
 
+/* Readers can't grow |bitset|, so bits beyond it are unset as far as they're
+ * concerned. */
+static bitset_error_t bitset_get_read_only(bitset_t *bitset, const uint64_t *bits, uint64_t *states, const uint64_t n) {
+  const bitset_error_t error = bitset_refresh(bitset);
+  if (error != BITSET_ERROR_NONE)
+    return error;
+
+  /* Must be loaded prior to our base pointer. See `bitset_refresh`. */
+  const uint64_t mapped = atomic_load_64(&bitset->mapped);
+
+  BITSET_OPERATION_START(bitset);
+
+  const uint64_t size = meta->size;
+  const uint64_t available = u_bytes_to_bits(mapped - sizeof(bitset_meta_t));
+  const uint64_t limit = (size < available) ? size : available;
+
+  for (uint64_t i = 0; i < n; ++i) {
+    const uint64_t bit = bits[i];
+    states[i] = (bit < limit) && !!(meta->bits[bit/64] & (1ull << (bit%64)));
+  }
+
+  BITSET_OPERATION_COMPLETE(bitset);
+
+  return BITSET_ERROR_NONE;
+}
+
 static bitset_error_t bitset_get(bitset_t *bitset, const uint64_t *bits, uint64_t *states, const uint64_t n) {
   assert(bitset != NULL);
   assert(bits != NULL);
   assert(states != NULL);
 
+  if (!bitset->writable)
+    return bitset_get_read_only(bitset, bits, states, n);
+
   const bitset_error_t error = bitset_grow_if_nessecary(bitset, bits, n);
   if (error != BITSET_ERROR_NONE)
     return error;
@@ -344,11 +531,10 @@ static bitset_error_t bitset_get(bitset_t *bitset, const uint64_t *bits, uint64_
 
   for (uint64_t i = 0; i < n; ++i) {
     const uint64_t bit = bits[i];
-    const uint64_t byte = bit/64;
   #if TRACE && VERBOSE
-    printf("[GET]   byte=%llu bit=%llu\n", byte, bit%64);
+    printf("[GET]   byte=%llu bit=%llu\n", bit/64, bit%64);
   #endif
-    states[i] = !!(meta->bits[bit/64] & (1 << (bit%64)));
+    states[i] = !!(meta->bits[bit/64] & (1ull << (bit%64)));
   }
 
   BITSET_OPERATION_COMPLETE(bitset);
@@ -360,6 +546,9 @@ static bitset_error_t bitset_set(bitset_t *bitset, const uint64_t *bits, const u
   assert(bitset != NULL);
   assert(bits != NULL);
 
+  if (!bitset->writable)
+    return BITSET_ERROR_PERMISSIONS;
+
   const bitset_error_t error = bitset_grow_if_nessecary(bitset, bits, n);
   if (error != BITSET_ERROR_NONE)
     return error;
@@ -371,7 +560,36 @@ static bitset_error_t bitset_set(bitset_t *bitset, const uint64_t *bits, const u
   #if TRACE && VERBOSE
     printf("[SET]   byte=%llu bit=%llu\n", bit/64, bit%64);
   #endif
-    meta->bits[bit/64] |= (1 << (bit%64));
+    meta->bits[bit/64] |= (1ull << (bit%64));
+  }
+
+  BITSET_OPERATION_COMPLETE(bitset);
+
+  return BITSET_ERROR_NONE;
+}
+
+static bitset_error_t bitset_test_and_set(bitset_t *bitset, const uint64_t *bits, uint64_t *states, const uint64_t n) {
+  assert(bitset != NULL);
+  assert(bits != NULL);
+  assert(states != NULL);
+
+  if (!bitset->writable)
+    return BITSET_ERROR_PERMISSIONS;
+
+  const bitset_error_t error = bitset_grow_if_nessecary(bitset, bits, n);
+  if (error != BITSET_ERROR_NONE)
+    return error;
+
+  BITSET_OPERATION_START(bitset);
+
+  for (uint64_t i = 0; i < n; ++i) {
+    const uint64_t bit = bits[i];
+    const uint64_t mask = (1ull << (bit%64));
+  #if TRACE && VERBOSE
+    printf("[TAS]   byte=%llu bit=%llu\n", bit/64, bit%64);
+  #endif
+    states[i] = !!(meta->bits[bit/64] & mask);
+    meta->bits[bit/64] |= mask;
   }
 
   BITSET_OPERATION_COMPLETE(bitset);
@@ -383,6 +601,9 @@ static bitset_error_t bitset_unset(bitset_t *bitset, const uint64_t *bits, const
   assert(bitset != NULL);
   assert(bits != NULL);
 
+  if (!bitset->writable)
+    return BITSET_ERROR_PERMISSIONS;
+
   const bitset_error_t error = bitset_grow_if_nessecary(bitset, bits, n);
   if (error != BITSET_ERROR_NONE)
     return error;
@@ -394,7 +615,117 @@ static bitset_error_t bitset_unset(bitset_t *bitset, const uint64_t *bits, const
   #if TRACE && VERBOSE
     printf("[UNSET] byte=%llu bit=%llu\n", bit/64, bit%64);
   #endif
-    meta->bits[bit/64] &= ~(1 << (bit%64));
+    meta->bits[bit/64] &= ~(1ull << (bit%64));
+  }
+
+  BITSET_OPERATION_COMPLETE(bitset);
+
+  return BITSET_ERROR_NONE;
+}
+
+static bitset_error_t bitset_fill_range(bitset_t *bitset, const uint64_t first, const uint64_t last, const bool state) {
+  assert(bitset != NULL);
+  assert(first <= last);
+
+  if (!bitset->writable)
+    return BITSET_ERROR_PERMISSIONS;
+
+  const bitset_error_t error = bitset_grow_if_nessecary(bitset, &last, 1);
+  if (error != BITSET_ERROR_NONE)
+    return error;
+
+  BITSET_OPERATION_START(bitset);
+
+  const uint64_t first_word = first / 64;
+  const uint64_t last_word = last / 64;
+
+  /* Only the edges need masking. Everything in between is filled wholesale. */
+  const uint64_t first_mask = ~0ull << (first % 64);
+  const uint64_t last_mask = ~0ull >> (63 - (last % 64));
+
+#if TRACE && VERBOSE
+  printf("[FILL]  first=%llu last=%llu state=%d\n", first, last, state);
+#endif
+
+  if (first_word == last_word) {
+    const uint64_t mask = first_mask & last_mask;
+    if (state)
+      meta->bits[first_word] |= mask;
+    else
+      meta->bits[first_word] &= ~mask;
+  } else {
+    if (state) {
+      meta->bits[first_word] |= first_mask;
+      meta->bits[last_word] |= last_mask;
+    } else {
+      meta->bits[first_word] &= ~first_mask;
+      meta->bits[last_word] &= ~last_mask;
+    }
+
+    memset((void *)&meta->bits[first_word + 1],
+           state ? 0xff : 0x00,
+           (last_word - first_word - 1) * sizeof(uint64_t));
+  }
+
+  BITSET_OPERATION_COMPLETE(bitset);
+
+  return BITSET_ERROR_NONE;
+}
+
+/* Returns the |index|th word of |meta|, ignoring any bits at or beyond
+ * |limit|. */
+static uint64_t bitset_word_within(const bitset_meta_t *meta, const uint64_t index, const uint64_t limit) {
+  if (index >= limit / 64) {
+    if ((index > limit / 64) || (limit % 64 == 0))
+      return 0;
+    return meta->bits[index] & (~0ull >> (64 - (limit % 64)));
+  }
+
+  return meta->bits[index];
+}
+
+static bitset_error_t bitset_get_range(bitset_t *bitset, const uint64_t first, const uint64_t last, uint8_t *packed) {
+  assert(bitset != NULL);
+  assert(first <= last);
+  assert(packed != NULL);
+
+  const bitset_error_t error = bitset->writable ? bitset_grow_if_nessecary(bitset, &last, 1)
+                                                : bitset_refresh(bitset);
+  if (error != BITSET_ERROR_NONE)
+    return error;
+
+  /* Must be loaded prior to our base pointer. See `bitset_refresh`. */
+  const uint64_t mapped = atomic_load_64(&bitset->mapped);
+
+  BITSET_OPERATION_START(bitset);
+
+  /* Readers may not have (all of) the range mapped. */
+  const uint64_t size = meta->size;
+  const uint64_t available = u_bytes_to_bits(mapped - sizeof(bitset_meta_t));
+  const uint64_t limit = (size < available) ? size : available;
+
+  const uint64_t n = last - first + 1;
+  const uint64_t bytes = u_bits_to_bytes(n);
+
+  const uint64_t base = first / 64;
+  const uint64_t shift = first % 64;
+
+  /* Every iteration extracts a word's worth of (unaligned) bits. */
+  for (uint64_t i = 0; i < (n + 63) / 64; ++i) {
+    uint64_t word = bitset_word_within(meta, base + i, limit) >> shift;
+    if (shift)
+      word |= bitset_word_within(meta, base + i + 1, limit) << (64 - shift);
+
+    if ((i == n / 64) && (n % 64))
+      /* Don't leak anything beyond |last|. */
+      word &= ~0ull >> (64 - (n % 64));
+
+    const uint64_t remaining = bytes - i * 8;
+    const uint64_t count = (remaining < 8) ? remaining : 8;
+
+    /* We store least significant bit first, but bitstrings are the opposite. */
+    for (uint64_t j = 0; j < count; ++j)
+      packed[i * 8 + j] = u_reverse_byte((uint8_t)(word >> (j * 8)));
   }
 
   BITSET_OPERATION_COMPLETE(bitset);
@@ -483,14 +814,16 @@ static bitset_error_t bitset_resize(bitset_t *bitset, const uint64_t bits) {
     bitset_wait_for_operations_in_progress(bitset);
   }
 
-  const uint64_t prev_size_on_disk =
-    bitset_size_on_disk(BITSET_META(bitset)->size);
-  const uint64_t prev_size_in_mem =
-    bitset_size_in_memory(BITSET_META(bitset)->size);
+  const uint64_t prev_size_in_mem = atomic_load_64(&bitset->mapped);
 
   const uint64_t size_on_disk = bitset_size_on_disk(bits);
   const uint64_t size_in_mem = bitset_size_in_memory(bits);
 
+  if (shrinking && bitset_has_readers(bitset->fd)) {
+    /* Readers would fault if we truncated the file out from under them. */
+    goto success;
+  }
+
 #if TRACE
   printf("[RESIZE] Resizing backing file.\n");
 #endif
@@ -522,11 +855,14 @@ static bitset_error_t bitset_resize(bitset_t *bitset, const uint64_t bits) {
    * completed prior to unmapping the previous mapping.*/
   bitset_wait_for_operations_in_progress(bitset);
 
+  atomic_store_64(&bitset->mapped, size_in_mem);
+
   munmap(old_base_ptr, prev_size_in_mem);
 
-  /* Finally, we can advertise the new (larger) size. */
+  /* Finally, we can advertise the new (larger) size. Readers rely on us doing
+   * this last. See `bitset_refresh`. */
   BITSET_META(bitset)->size = bits;
-  msync((void *)meta, sizeof(bitset_meta_t), MS_SYNC);
+  msync((void *)new_base_ptr, sizeof(bitset_meta_t), MS_SYNC);
 
 success:
 #if TRACE
@@ -536,6 +872,8 @@ success:
   return BITSET_ERROR_NONE;
 
 error:
+  atomic_store_64(&bitset->locked, FALSE);
+
   if (errno == ENOMEM)
     return BITSET_ERROR_OUT_OF_MEMORY;
   if (errno == EOVERFLOW)
@@ -546,6 +884,56 @@ error:
   return BITSET_ERROR_UNKNOWN;
 }
 
+static bitset_error_t bitset_refresh(bitset_t *bitset) {
+  assert(bitset != NULL);
+  assert(!bitset->writable);
+
+  /* Our writer extends the backing file prior to advertising a larger size, so
+   * it's always safe to map as much as is advertised. */
+  const uint64_t size_in_mem = bitset_size_in_memory(BITSET_META(bitset)->size);
+
+  if (size_in_mem <= atomic_load_64(&bitset->mapped))
+    return BITSET_ERROR_NONE;
+
+  if (atomic_cmp_and_xchg_64(&bitset->locked, FALSE, TRUE) != FALSE) {
+    /* Another thread is already remapping this bitset so we'll wait. */
+    while (atomic_load_64(&bitset->locked));
+    return bitset_refresh(bitset);
+  }
+
+#if TRACE
+  printf("[REFRESH] Replacing mapping.\n");
+#endif
+
+  const uint64_t prev_size_in_mem = atomic_load_64(&bitset->mapped);
+
+  void *old_base_ptr =
+    atomic_load_ptr(&bitset->base);
+
+  void *new_base_ptr =
+    mmap(NULL, size_in_mem, PROT_READ, MAP_SHARED, bitset->fd, 0);
+
+  if (new_base_ptr == MAP_FAILED) {
+    atomic_store_64(&bitset->locked, FALSE);
+    if (errno == ENOMEM)
+      return BITSET_ERROR_OUT_OF_MEMORY;
+    return BITSET_ERROR_UNKNOWN;
+  }
+
+  /* Operations load how much we've mapped prior to where, so we publish the
+   * new mapping before its size. Then nobody reads past whichever mapping
+   * they're using. */
+  atomic_store_ptr(&bitset->base, new_base_ptr);
+  bitset_wait_for_operations_in_progress(bitset);
+  atomic_store_64(&bitset->mapped, size_in_mem);
+
+  munmap(old_base_ptr, prev_size_in_mem);
+
+  atomic_store_64(&bitset->locked, FALSE);
+
+  return BITSET_ERROR_NONE;
+}
+
 static bitset_error_t bitset_grow_if_nessecary(bitset_t *bitset, const uint64_t *bits, const uint64_t n) {
   const uint64_t highest = u_highest_in_array(bits, n);
 
@@ -574,6 +962,32 @@ static bitset_error_t bitset_grow_if_nessecary(bitset_t *bitset, const uint64_t
 
 static ErlNifResourceType *bitset_nif_resource_type;
 
+typedef struct bitset_nif_boxed {
+  bitset_t *bitset;
+
+  /* Operations hold this for reading and closing holds it for writing, so a
+   * bitset is never closed out from under an operation. */
+  ErlNifRWLock *lock;
+
+  /* Set once closed, so we never close twice. */
+  bool closed;
+} bitset_nif_boxed_t;
+
+/* Handles that are never closed still have to release their lock, lest the
+ * bitset stays locked until we exit. We're likely on a normal scheduler, so we
+ * leave flushing to the kernel rather than wait on it.
+ *
+ * Nobody else can reference |obj| by now, so there's no need to lock. */
+static void bitset_nif_destroy(ErlNifEnv *env, void *obj) {
+  bitset_nif_boxed_t *boxed = (bitset_nif_boxed_t *)obj;
+
+  if (!boxed->closed)
+    bitset_close(boxed->bitset, false, false);
+
+  bitset_free(boxed->bitset);
+  enif_rwlock_destroy(boxed->lock);
+}
+
 static ERL_NIF_TERM BITSET_NIF_OK;
 static ERL_NIF_TERM BITSET_NIF_ERROR;
 
@@ -582,6 +996,8 @@ static ERL_NIF_TERM BITSET_NIF_UNSUPPORTED;
 static ERL_NIF_TERM BITSET_NIF_PERMISSIONS;
 static ERL_NIF_TERM BITSET_NIF_OUT_OF_MEMORY;
 static ERL_NIF_TERM BITSET_NIF_OUT_OF_STORAGE;
+static ERL_NIF_TERM BITSET_NIF_NOT_FOUND;
+static ERL_NIF_TERM BITSET_NIF_LOCKED;
 
 static ERL_NIF_TERM BITSET_NIF_UNKNOWN;
 
@@ -611,6 +1027,20 @@ bitset_nif_options_from_keyword(ErlNifEnv *env, const ERL_NIF_TERM keyword, bits
       if (size < 0)
         return enif_make_tuple2(env, BITSET_NIF_ERROR, enif_make_string(env, "Expected `size` to be an non-negative integer.", ERL_NIF_LATIN1));
       options->size = size;
+    } else if (enif_is_identical(tuple[0], enif_make_atom(env, "planes"))) {
+      ErlNifSInt64 planes;
+      if (!enif_get_int64(env, tuple[1], &planes))
+        return enif_make_tuple2(env, BITSET_NIF_ERROR, enif_make_string(env, "Expected `planes` to be a power of two between 1 and 64.", ERL_NIF_LATIN1));
+      if ((planes < 1) || (planes > (ErlNifSInt64)BITSET_MAX_PLANES) || (planes & (planes - 1)))
+        return enif_make_tuple2(env, BITSET_NIF_ERROR, enif_make_string(env, "Expected `planes` to be a power of two between 1 and 64.", ERL_NIF_LATIN1));
+      options->planes = planes;
+    } else if (enif_is_identical(tuple[0], enif_make_atom(env, "mode"))) {
+      if (enif_is_identical(tuple[1], enif_make_atom(env, "read_only")))
+        options->read_only = true;
+      else if (enif_is_identical(tuple[1], enif_make_atom(env, "read_write")))
+        options->read_only = false;
+      else
+        return enif_make_tuple2(env, BITSET_NIF_ERROR, enif_make_string(env, "Expected `mode` to be `:read_only` or `:read_write`.", ERL_NIF_LATIN1));
     } else {
       /* TODO(mtwilliams): Use `enif_get_atom` to provide a more helpful response. */
       return enif_make_tuple2(env, BITSET_NIF_ERROR, enif_make_string(env, "Unknown option provided.", ERL_NIF_LATIN1));
@@ -633,6 +1063,8 @@ bitset_nif_error_to_erlang(ErlNifEnv *env, const bitset_error_t error) {
     case BITSET_ERROR_PERMISSIONS: erlang = BITSET_NIF_PERMISSIONS; break;
     case BITSET_ERROR_OUT_OF_MEMORY: erlang = BITSET_NIF_OUT_OF_MEMORY; break;
     case BITSET_ERROR_OUT_OF_STORAGE: erlang = BITSET_NIF_OUT_OF_STORAGE; break;
+    case BITSET_ERROR_NOT_FOUND: erlang = BITSET_NIF_NOT_FOUND; break;
+    case BITSET_ERROR_LOCKED: erlang = BITSET_NIF_LOCKED; break;
   }
 
   return enif_make_tuple2(env, BITSET_NIF_ERROR, erlang);
@@ -659,6 +1091,8 @@ bitset_nif_open(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
 
   bitset_options_t options;
   options.size = 0;
+  options.planes = 0;
+  options.read_only = false;
 
   if (argc >= 2) {
     ERL_NIF_TERM result = bitset_nif_options_from_keyword(env, argv[1], &options);
@@ -671,19 +1105,35 @@ bitset_nif_open(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
   if (result != BITSET_ERROR_NONE)
     return bitset_nif_error_to_erlang(env, result);
 
-  void *boxed = enif_alloc_resource(bitset_nif_resource_type, sizeof(bitset_t *));
-  *((bitset_t **)boxed) = bitset;
+  bitset_nif_boxed_t *boxed = enif_alloc_resource(bitset_nif_resource_type, sizeof(bitset_nif_boxed_t));
+  boxed->bitset = bitset;
+  boxed->lock = enif_rwlock_create("bitset");
+  boxed->closed = false;
 
-  return enif_make_tuple2(env, BITSET_NIF_OK, enif_make_resource(env, boxed));
+  /* Garbage collection owns |boxed| from here on out. */
+  const ERL_NIF_TERM resource = enif_make_resource(env, (void *)boxed);
+  enif_release_resource((void *)boxed);
+
+  return enif_make_tuple2(env, BITSET_NIF_OK, resource);
 }
 
 static ERL_NIF_TERM
 bitset_nif_do_close(ErlNifEnv *env, const ERL_NIF_TERM resource, bool del) {
-  void *boxed;
-  if (!enif_get_resource(env, resource, bitset_nif_resource_type, &boxed))
+  bitset_nif_boxed_t *boxed;
+  if (!enif_get_resource(env, resource, bitset_nif_resource_type, (void **)&boxed))
     return enif_make_badarg(env);
-  bitset_close(*((bitset_t **)boxed), del);
-  enif_release_resource(boxed);
+
+  /* Waits for operations in progress. The bitset itself is freed once it's
+   * garbage collected, so stragglers can still tell that it's closed. */
+  enif_rwlock_rwlock(boxed->lock);
+
+  if (!boxed->closed) {
+    bitset_close(boxed->bitset, del, true);
+    boxed->closed = true;
+  }
+
+  enif_rwlock_rwunlock(boxed->lock);
+
   return BITSET_NIF_OK;
 }
 
@@ -697,18 +1147,33 @@ bitset_nif_delete(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
   return bitset_nif_do_close(env, argv[0], true);
 }
 
-#define BITSET_NIF_UNBOX(env, term) \
-  bitset_t *bitset = bitset_nif_unbox((env), (term)); \
-  if (!bitset) { return enif_make_badarg(env); }
+typedef ERL_NIF_TERM (*bitset_nif_operation_t)(ErlNifEnv *env, bitset_t *bitset, const ERL_NIF_TERM argv[]);
+
+/* Performs |operation| on the bitset in `argv[0]`, making sure it stays open
+ * until |operation| is done with it. */
+static ERL_NIF_TERM
+bitset_nif_perform(ErlNifEnv *env, const ERL_NIF_TERM argv[], bitset_nif_operation_t operation) {
+  bitset_nif_boxed_t *boxed;
+  if (!enif_get_resource(env, argv[0], bitset_nif_resource_type, (void **)&boxed))
+    return enif_make_badarg(env);
+
+  enif_rwlock_rlock(boxed->lock);
+
+  if (boxed->closed) {
+    enif_rwlock_runlock(boxed->lock);
+    return enif_make_badarg(env);
+  }
+
+  const ERL_NIF_TERM result = operation(env, boxed->bitset, argv);
 
-static bitset_t *bitset_nif_unbox(ErlNifEnv *env, ERL_NIF_TERM term) {
-  void *boxed;
-  if (!enif_get_resource(env, term, bitset_nif_resource_type, &boxed))
-    return NULL;
-  return *((bitset_t **)boxed);
+  enif_rwlock_runlock(boxed->lock);
+
+  return result;
 }
 
-static bool bitset_nif_indicies_from_list(ErlNifEnv *env, ERL_NIF_TERM list, uint64_t **indicies, unsigned *count) {
+/* Translates a list of identifiers or `{identifier, plane}` pairs into bits.
+ * Bare identifiers refer to the first plane. */
+static bool bitset_nif_indicies_from_list(ErlNifEnv *env, const bitset_t *bitset, ERL_NIF_TERM list, uint64_t **indicies, unsigned *count) {
   if (!enif_get_list_length(env, list, count))
     return false;
 
@@ -717,19 +1182,35 @@ static bool bitset_nif_indicies_from_list(ErlNifEnv *env, ERL_NIF_TERM list, uin
   unsigned n = 0;
   ERL_NIF_TERM head, tail = list;
   while (enif_get_list_cell(env, tail, &head, &tail)) {
-    ErlNifSInt64 index;
-    if (!enif_get_int64(env, head, &index))
+    ErlNifSInt64 index, plane = 0;
+
+    int arity;
+    const ERL_NIF_TERM *pair;
+
+    if (enif_get_tuple(env, head, &arity, &pair)) {
+      if (arity != 2)
+        goto badarg;
+      if (!enif_get_int64(env, pair[0], &index))
+        goto badarg;
+      if (!enif_get_int64(env, pair[1], &plane))
+        goto badarg;
+    } else if (!enif_get_int64(env, head, &index)) {
       goto badarg;
+    }
+
     if (index < 0)
       goto badarg;
-    (*indicies)[n++] = index;
+    if ((plane < 0) || ((uint64_t)plane >= bitset->planes))
+      goto badarg;
+
+    (*indicies)[n++] = bitset_bit(bitset, index, plane);
   }
 
   assert(n == (*count));
   return true;
 
 badarg:
-  enif_free((void *)indicies);
+  enif_free((void *)*indicies);
   return false;
 }
 
@@ -746,12 +1227,10 @@ bitset_nif_list_from_states(ErlNifEnv *env, const uint64_t *states, const uint64
 }
 
 static ERL_NIF_TERM
-bitset_nif_get(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
-  BITSET_NIF_UNBOX(env, argv[0]);
-
+bitset_nif_do_get(ErlNifEnv *env, bitset_t *bitset, const ERL_NIF_TERM argv[]) {
   uint64_t *bits;
   unsigned count;
-  if (!bitset_nif_indicies_from_list(env, argv[1], &bits, &count))
+  if (!bitset_nif_indicies_from_list(env, bitset, argv[1], &bits, &count))
     return enif_make_badarg(env);
 
   uint64_t *states = (uint64_t *)enif_alloc(count * sizeof(uint64_t));
@@ -773,12 +1252,10 @@ bitset_nif_get(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
 }
 
 static ERL_NIF_TERM
-bitset_nif_set(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
-  BITSET_NIF_UNBOX(env, argv[0]);
-
+bitset_nif_do_set(ErlNifEnv *env, bitset_t *bitset, const ERL_NIF_TERM argv[]) {
   uint64_t *bits;
   unsigned count;
-  if (!bitset_nif_indicies_from_list(env, argv[1], &bits, &count))
+  if (!bitset_nif_indicies_from_list(env, bitset, argv[1], &bits, &count))
     return enif_make_badarg(env);
 
   const bitset_error_t result = bitset_set(bitset, bits, count);
@@ -792,12 +1269,34 @@ bitset_nif_set(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
 }
 
 static ERL_NIF_TERM
-bitset_nif_unset(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
-  BITSET_NIF_UNBOX(env, argv[0]);
+bitset_nif_do_test_and_set(ErlNifEnv *env, bitset_t *bitset, const ERL_NIF_TERM argv[]) {
+  uint64_t *bits;
+  unsigned count;
+  if (!bitset_nif_indicies_from_list(env, bitset, argv[1], &bits, &count))
+    return enif_make_badarg(env);
 
+  uint64_t *states = (uint64_t *)enif_alloc(count * sizeof(uint64_t));
+  memset((void *)states, 0, count * sizeof(uint64_t));
+
+  const bitset_error_t result = bitset_test_and_set(bitset, bits, states, count);
+
+  enif_free((void *)bits);
+
+  if (result != BITSET_ERROR_NONE) {
+    enif_free((void *)states);
+    return bitset_nif_error_to_erlang(env, result);
+  }
+
+  ERL_NIF_TERM translated = bitset_nif_list_from_states(env, states, count);
+  enif_free((void *)states);
+  return enif_make_tuple2(env, BITSET_NIF_OK, translated);
+}
+
+static ERL_NIF_TERM
+bitset_nif_do_unset(ErlNifEnv *env, bitset_t *bitset, const ERL_NIF_TERM argv[]) {
   uint64_t *bits;
   unsigned count;
-  if (!bitset_nif_indicies_from_list(env, argv[1], &bits, &count))
+  if (!bitset_nif_indicies_from_list(env, bitset, argv[1], &bits, &count))
     return enif_make_badarg(env);
 
   const bitset_error_t result = bitset_unset(bitset, bits, count);
@@ -810,6 +1309,102 @@ bitset_nif_unset(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
   return BITSET_NIF_OK;
 }
 
+/* Translates an inclusive range of identifiers into the range of bits that
+ * covers every plane of them. */
+static bool bitset_nif_range_from_terms(ErlNifEnv *env, const bitset_t *bitset, ERL_NIF_TERM from, ERL_NIF_TERM to, uint64_t *first, uint64_t *last) {
+  ErlNifSInt64 low, high;
+  if (!enif_get_int64(env, from, &low) || !enif_get_int64(env, to, &high))
+    return false;
+  if ((low < 0) || (high < low))
+    return false;
+  *first = bitset_bit(bitset, low, 0);
+  *last = bitset_bit(bitset, high, bitset->planes - 1);
+  return true;
+}
+
+static ERL_NIF_TERM
+bitset_nif_do_fill_range(ErlNifEnv *env, bitset_t *bitset, const ERL_NIF_TERM argv[], bool state) {
+  uint64_t first, last;
+  if (!bitset_nif_range_from_terms(env, bitset, argv[1], argv[2], &first, &last))
+    return enif_make_badarg(env);
+
+  const bitset_error_t result = bitset_fill_range(bitset, first, last, state);
+
+  if (result != BITSET_ERROR_NONE)
+    return bitset_nif_error_to_erlang(env, result);
+
+  return BITSET_NIF_OK;
+}
+
+static ERL_NIF_TERM
+bitset_nif_do_set_range(ErlNifEnv *env, bitset_t *bitset, const ERL_NIF_TERM argv[]) {
+  return bitset_nif_do_fill_range(env, bitset, argv, true);
+}
+
+static ERL_NIF_TERM
+bitset_nif_do_unset_range(ErlNifEnv *env, bitset_t *bitset, const ERL_NIF_TERM argv[]) {
+  return bitset_nif_do_fill_range(env, bitset, argv, false);
+}
+
+static ERL_NIF_TERM
+bitset_nif_do_get_range(ErlNifEnv *env, bitset_t *bitset, const ERL_NIF_TERM argv[]) {
+  uint64_t first, last;
+  if (!bitset_nif_range_from_terms(env, bitset, argv[1], argv[2], &first, &last))
+    return enif_make_badarg(env);
+
+  ErlNifBinary packed;
+  if (!enif_alloc_binary(u_bits_to_bytes(last - first + 1), &packed))
+    return bitset_nif_error_to_erlang(env, BITSET_ERROR_OUT_OF_MEMORY);
+
+  const bitset_error_t result = bitset_get_range(bitset, first, last, packed.data);
+
+  if (result != BITSET_ERROR_NONE) {
+    enif_release_binary(&packed);
+    return bitset_nif_error_to_erlang(env, result);
+  }
+
+  /* We can only hand back whole bytes, so tell our caller how many bits are
+   * meaningful. */
+  return enif_make_tuple3(env, BITSET_NIF_OK,
+                               enif_make_binary(env, &packed),
+                               enif_make_uint64(env, last - first + 1));
+}
+
+static ERL_NIF_TERM
+bitset_nif_get(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+  return bitset_nif_perform(env, argv, &bitset_nif_do_get);
+}
+
+static ERL_NIF_TERM
+bitset_nif_set(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+  return bitset_nif_perform(env, argv, &bitset_nif_do_set);
+}
+
+static ERL_NIF_TERM
+bitset_nif_unset(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+  return bitset_nif_perform(env, argv, &bitset_nif_do_unset);
+}
+
+static ERL_NIF_TERM
+bitset_nif_test_and_set(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+  return bitset_nif_perform(env, argv, &bitset_nif_do_test_and_set);
+}
+
+static ERL_NIF_TERM
+bitset_nif_set_range(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+  return bitset_nif_perform(env, argv, &bitset_nif_do_set_range);
+}
+
+static ERL_NIF_TERM
+bitset_nif_unset_range(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+  return bitset_nif_perform(env, argv, &bitset_nif_do_unset_range);
+}
+
+static ERL_NIF_TERM
+bitset_nif_get_range(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+  return bitset_nif_perform(env, argv, &bitset_nif_do_get_range);
+}
+
 static ErlNifFunc bitset_nif_funcs[] = {
   {"open",   1, &bitset_nif_open,   ERL_NIF_DIRTY_JOB_IO_BOUND},
   {"open",   2, &bitset_nif_open,   ERL_NIF_DIRTY_JOB_IO_BOUND},
@@ -817,11 +1412,15 @@ static ErlNifFunc bitset_nif_funcs[] = {
   {"delete", 1, &bitset_nif_delete, ERL_NIF_DIRTY_JOB_IO_BOUND},
   {"get",    2, &bitset_nif_get,    ERL_NIF_DIRTY_JOB_CPU_BOUND},
   {"set",    2, &bitset_nif_set,    ERL_NIF_DIRTY_JOB_CPU_BOUND},
-  {"unset",  2, &bitset_nif_unset,  ERL_NIF_DIRTY_JOB_CPU_BOUND}
+  {"unset",  2, &bitset_nif_unset,  ERL_NIF_DIRTY_JOB_CPU_BOUND},
+  {"test_and_set", 2, &bitset_nif_test_and_set, ERL_NIF_DIRTY_JOB_CPU_BOUND},
+  {"set_range",    3, &bitset_nif_set_range,    ERL_NIF_DIRTY_JOB_CPU_BOUND},
+  {"unset_range",  3, &bitset_nif_unset_range,  ERL_NIF_DIRTY_JOB_CPU_BOUND},
+  {"get_range_packed", 3, &bitset_nif_get_range, ERL_NIF_DIRTY_JOB_CPU_BOUND}
 };
 
 static int bitset_nif_load(ErlNifEnv *env, void **priv_data, ERL_NIF_TERM load_info) {
-  bitset_nif_resource_type = enif_open_resource_type(env, NULL, "bitset", NULL, ERL_NIF_RT_CREATE, NULL);
+  bitset_nif_resource_type = enif_open_resource_type(env, NULL, "bitset", &bitset_nif_destroy, ERL_NIF_RT_CREATE, NULL);
   if (!bitset_nif_resource_type)
     return 1;
 
@@ -833,6 +1432,8 @@ static int bitset_nif_load(ErlNifEnv *env, void **priv_data, ERL_NIF_TERM load_i
   BITSET_NIF_PERMISSIONS = enif_make_atom(env, "permissions");
   BITSET_NIF_OUT_OF_MEMORY = enif_make_atom(env, "out_of_memory");
   BITSET_NIF_OUT_OF_STORAGE = enif_make_atom(env, "out_of_storage");
+  BITSET_NIF_NOT_FOUND = enif_make_atom(env, "not_found");
+  BITSET_NIF_LOCKED = enif_make_atom(env, "locked");
 
   BITSET_NIF_UNKNOWN = enif_make_atom(env, "unknown");
 
@@ -5,6 +5,9 @@ defmodule GithubViz do
   use Application
 
   def start(_type, _args) do
+    # Tables are owned by us, so they live as long as the application.
+    :ok = GithubViz.Metrics.init()
+
     GithubViz.Supervisor.start_link()
   end
 end
@@ -1,11 +1,26 @@
 defmodule GithubViz.Bitset do
   @moduledoc ~S"""
   Our custom resizeable, out-of-core, file-backed bitset.
+
+  ## Planes
+
+  A bitset can hold more than one bit, or plane, per identifier. Every plane
+  of an identifier is stored alongside the others, so operating on all of them
+  touches memory once. Bits are addressed as `{identifier, plane}` or simply
+  as `identifier` for the first plane.
+
+  ## Sharing
+
+  Only one process can have a bitset open for writing at a time, but any
+  number can open it with `mode: :read_only` alongside. Readers map the same
+  pages as the writer, so they see its changes without copying, and pick up
+  any growth when they next read. Bits beyond what's been written read as
+  unset.
   """
 
   @type t :: reference()
 
-  @type bit :: non_neg_integer
+  @type bit :: non_neg_integer | {non_neg_integer, non_neg_integer}
   @type state :: 0 | 1
 
   @type error :: {:error, :not_a_bitset} |
@@ -13,27 +28,50 @@ defmodule GithubViz.Bitset do
                  {:error, :permissions} |
                  {:error, :out_of_memory} |
                  {:error, :out_of_storage} |
-                 {:error, :uknown}
+                 {:error, :not_found} |
+                 {:error, :locked} |
+                 {:error, :unknown}
 
-  @spec open(path :: Path.t, options :: [{:size, non_neg_integer}]) :: {:ok, t} | error
+  @type mode :: :read_write | :read_only
+
+  @spec open(path :: Path.t, options :: [{:size, non_neg_integer} |
+                                          {:planes, pos_integer} |
+                                          {:mode, mode}]) :: {:ok, t} | error
   @doc """
   Opens or creates a new file-backed bitset.
 
   ## Options
 
-    * `:size` – the initial number of bits to size or resize the bitset to.
+    * `:size` – the initial number of identifiers to size or resize the
+      bitset to.
+    * `:planes` – the number of bits per identifier. Must be a power of two
+      no greater than 64. Defaults to one for new bitsets. Opening an existing
+      bitset with a different number of planes fails with
+      `{:error, :unsupported}`.
+    * `:mode` – either `:read_write` or `:read_only`. Defaults to
+      `:read_write`, which creates the bitset if it doesn't exist and fails
+      with `{:error, :locked}` if someone else has it open for writing.
+      Opening for reading fails with `{:error, :not_found}` if it doesn't
+      exist. Readers can't set, unset, or delete bits, and get
+      `{:error, :permissions}` if they try.
   """
   def open(path, options \\ []), do: stub()
 
   @spec close(bitset :: t) :: :ok
   @doc """
   Closes a bitset, making sure to persist changes to the backing file.
+
+  Bitsets are closed when garbage collected if they haven't been already, but
+  don't rely on it; until then writers hold their lock. Closing a closed
+  bitset does nothing, and any other operation on one raises.
   """
   def close(bitset), do: stub()
 
   @spec delete(bitset :: t) :: :ok
   @doc """
   Closes a bitset and deletes the backing file.
+
+  Readers only close the bitset.
   """
   def delete(bitset), do: stub()
 
@@ -64,6 +102,56 @@ defmodule GithubViz.Bitset do
   """
   def unset(bitset, bits) when is_list(bits), do: stub()
 
+  @spec test_and_set(bitset :: t, bits :: [bit]) :: {:ok, [state]} | error
+  @doc """
+  Sets every bit in `bits`, returning the state of each prior.
+
+  Resizes the bitset to encompass the largest bit specified in `bits` if it is
+  too small.
+  """
+  def test_and_set(bitset, bits) when is_list(bits), do: stub()
+
+  @spec get_range(bitset :: t, first :: non_neg_integer, last :: non_neg_integer) :: {:ok, bitstring} | error
+  @doc """
+  Gets the state of every plane of every identifier from `first` to `last`
+  inclusive, packed into a bitstring.
+
+  Plane `p` of identifier `first + i` is bit `i * planes + p` of the result,
+  counting from the most significant bit of the first byte, so
+  `for <<state::1 <- packed>>` walks them in order. The result is exactly
+  `(last - first + 1) * planes` bits long.
+
+  Resizes the bitset to encompass `last` if it is too small.
+  """
+  def get_range(bitset, first, last) do
+    case get_range_packed(bitset, first, last) do
+      {:ok, packed, size} ->
+        # Drop the padding out to a whole byte.
+        <<bits::bitstring-size(size), _::bitstring>> = packed
+        {:ok, bits}
+      error ->
+        error
+    end
+  end
+
+  defp get_range_packed(bitset, first, last), do: stub()
+
+  @spec set_range(bitset :: t, first :: non_neg_integer, last :: non_neg_integer) :: :ok | error
+  @doc """
+  Sets every plane of every identifier from `first` to `last` inclusive.
+
+  Resizes the bitset to encompass `last` if it is too small.
+  """
+  def set_range(bitset, first, last), do: stub()
+
+  @spec unset_range(bitset :: t, first :: non_neg_integer, last :: non_neg_integer) :: :ok | error
+  @doc """
+  Unsets every plane of every identifier from `first` to `last` inclusive.
+
+  Resizes the bitset to encompass `last` if it is too small.
+  """
+  def unset_range(bitset, first, last), do: stub()
+
   @on_load :init
 
   @doc false
@@ -1,5 +1,33 @@
 defmodule GithubViz.Github.Event do
-  defstruct [:id, :type, :actor, :repository]
+  # Some events stand in for many identical ones, like commits in a push. Rather
+  # than generating each, we generate one and weight it by `count`.
+  #
+  # When Github says the event happened, in seconds since the epoch, if known.
+  defstruct [:id, :type, :actor, :repository, :created_at, count: 1]
+
+  # Every type of event we generate. Append only, as the position of each type
+  # is how it's identified in packed batches. See `GithubViz.Github.Event.Batch`.
+  @types ~W{repos.created repos.forked repos.open_sourced
+            code.pushes code.commits
+            pull_requests.opened pull_requests.reopened pull_requests.closed
+            issues.opened issues.reopened issues.closed
+            commit.comments issue.comments review.comments
+            collaborators.added collaborators.removed
+            wiki.edits releases}a
+
+  @doc "Returns every type of event we generate."
+  def types, do: @types
+
+  @doc false
+  def type_to_code(type)
+
+  @doc false
+  def code_to_type(code)
+
+  for {type, code} <- Enum.with_index(@types) do
+    def type_to_code(unquote(type)), do: unquote(code)
+    def code_to_type(unquote(code)), do: unquote(type)
+  end
 end
 
 defmodule GithubViz.Github.Event.Parser do
@@ -16,6 +44,7 @@ defmodule GithubViz.Github.Event.Parser do
     %GithubViz.Github.Event{
       id: id(event["id"]),
       type: type,
+      created_at: created_at(event["created_at"]),
       actor: %GithubViz.Github.Ref{
         id: id(event["actor"]["id"]),
         url: event["actor"]["url"]},
@@ -25,6 +54,15 @@ defmodule GithubViz.Github.Event.Parser do
     }
   end
 
+  defp created_at(raw) when is_binary(raw) do
+    case DateTime.from_iso8601(raw) do
+      {:ok, at, _} -> DateTime.to_unix(at)
+      _ -> nil
+    end
+  end
+
+  defp created_at(_), do: nil
+
   defp id(raw) when is_integer(raw), do: raw
   defp id(raw) when is_binary(raw) do
     {parsed, ""} = Integer.parse(raw)
@@ -48,11 +86,13 @@ defmodule GithubViz.Github.Event.Parser do
   defp do_parse(%{"type" => "PushEvent"} = event) do
     push = generate(:"code.pushes", event)
 
-    # HACK(mtwilliams): Not necessarily the author of the commits...
-    commits = Stream.repeatedly(fn -> generate(:"code.commits", event) end)
-           |> Enum.take(event["payload"]["distinct_size"])
-
-    [push | commits]
+    case event["payload"]["distinct_size"] do
+      commits when is_integer(commits) and commits > 0 ->
+        # HACK(mtwilliams): Not necessarily the author of the commits...
+        [push, %GithubViz.Github.Event{generate(:"code.commits", event) | count: commits}]
+      _ ->
+        push
+    end
   end
 
   defp do_parse(%{"type" => "PullRequestEvent"} = event) do
@@ -0,0 +1,160 @@
+defmodule GithubViz.Github.Event.Batch do
+  @moduledoc ~S"""
+  A packed, columnar batch of `GithubViz.Github.Event`s.
+
+  Events are packed into fixed-size records in a single binary, with the URLs
+  they reference packed into a second. Both are large enough to be reference
+  counted, so sending a batch to another process copies a handful of words
+  rather than every event, no matter how many processes we send it to.
+
+  Each record is laid out as follows:
+
+      <<id::64, type::8, count::32, created_at::64, actor::64, repository::64,
+        actor_url_offset::32, actor_url_size::16,
+        repository_url_offset::32, repository_url_size::16>>
+
+  Events without a `created_at` are packed with zero in its place.
+
+  Use the accessors (or `Enum`) rather than picking batches apart yourself.
+  """
+
+  alias GithubViz.Github.Event
+  alias GithubViz.Github.Ref
+
+  @record 49
+
+  defstruct [size: 0, records: <<>>, urls: <<>>]
+
+  @type t :: %__MODULE__{size: non_neg_integer, records: binary, urls: binary}
+
+  @spec pack(events :: [Event.t]) :: t
+  @doc "Packs `events` into a batch."
+  def pack(events) do
+    {records, urls, size, _} =
+      Enum.reduce events, {[], [], 0, 0}, fn (event, {records, urls, size, offset}) ->
+        actor_url = event.actor.url || ""
+        repository_url = event.repository.url || ""
+        actor_url_size = byte_size(actor_url)
+        repository_url_size = byte_size(repository_url)
+        repository_url_offset = offset + actor_url_size
+
+        record = <<event.id::64, Event.type_to_code(event.type)::8, event.count::32,
+                   (event.created_at || 0)::64, event.actor.id::64, event.repository.id::64,
+                   offset::32, actor_url_size::16,
+                   repository_url_offset::32, repository_url_size::16>>
+
+        {[record | records],
+         [repository_url, actor_url | urls],
+         size + 1,
+         repository_url_offset + repository_url_size}
+      end
+
+    %__MODULE__{size: size,
+                records: IO.iodata_to_binary(Enum.reverse(records)),
+                urls: IO.iodata_to_binary(Enum.reverse(urls))}
+  end
+
+  @spec size(batch :: t) :: non_neg_integer
+  @doc "Returns the number of events in `batch`."
+  def size(%__MODULE__{size: size}), do: size
+
+  @spec ids(batch :: t) :: [non_neg_integer]
+  @doc "Returns the identifier of every event in `batch`, in order."
+  def ids(%__MODULE__{records: records}) do
+    for <<id::64, _::binary-size(41) <- records>>, do: id
+  end
+
+  @spec types(batch :: t) :: [atom]
+  @doc "Returns the type of every event in `batch`, in order."
+  def types(%__MODULE__{records: records}) do
+    for <<_::64, type::8, _::binary-size(40) <- records>>, do: Event.code_to_type(type)
+  end
+
+  @spec counts(batch :: t) :: [pos_integer]
+  @doc "Returns the weight of every event in `batch`, in order."
+  def counts(%__MODULE__{records: records}) do
+    for <<_::72, count::32, _::binary-size(36) <- records>>, do: count
+  end
+
+  @spec created_at(batch :: t) :: [non_neg_integer | nil]
+  @doc "Returns when every event in `batch` happened (if known), in order."
+  def created_at(%__MODULE__{records: records}) do
+    for <<_::104, created_at::64, _::binary-size(28) <- records>> do
+      if created_at == 0, do: nil, else: created_at
+    end
+  end
+
+  @spec total(batch :: t) :: non_neg_integer
+  @doc "Returns the total weight of every event in `batch`."
+  def total(%__MODULE__{} = batch) do
+    Enum.sum(counts(batch))
+  end
+
+  @spec at(batch :: t, index :: non_neg_integer) :: Event.t
+  @doc "Unpacks the event at `index` in `batch`."
+  def at(%__MODULE__{size: size} = batch, index) when index < size do
+    unpack(binary_part(batch.records, index * @record, @record), batch.urls)
+  end
+
+  @spec take(batch :: t, keep :: [boolean]) :: t
+  @doc """
+  Returns a batch of the events in `batch` for which the corresponding element
+  of `keep` is `true`.
+
+  The URLs are shared rather than copied, and if every event is kept `batch`
+  is returned as is.
+  """
+  def take(%__MODULE__{} = batch, keep) do
+    if Enum.all?(keep) do
+      batch
+    else
+      records =
+        for {record, true} <- Enum.zip(records(batch), keep), do: record
+
+      %__MODULE__{batch | size: length(records),
+                          records: IO.iodata_to_binary(records)}
+    end
+  end
+
+  defp records(%__MODULE__{records: records}) do
+    for <<record::binary-size(@record) <- records>>, do: record
+  end
+
+  defp unpack(<<id::64, type::8, count::32, created_at::64, actor::64, repository::64,
+                actor_url_offset::32, actor_url_size::16,
+                repository_url_offset::32, repository_url_size::16>>, urls) do
+    %Event{
+      id: id,
+      type: Event.code_to_type(type),
+      count: count,
+      created_at: (if created_at == 0, do: nil, else: created_at),
+      actor: %Ref{
+        id: actor,
+        url: binary_part(urls, actor_url_offset, actor_url_size)},
+      repository: %Ref{
+        id: repository,
+        url: binary_part(urls, repository_url_offset, repository_url_size)}
+    }
+  end
+
+  defimpl Enumerable do
+    alias GithubViz.Github.Event.Batch
+
+    def count(batch), do: {:ok, Batch.size(batch)}
+
+    def member?(_batch, _event), do: {:error, __MODULE__}
+
+    def slice(batch) do
+      {:ok, Batch.size(batch), fn (start, length) ->
+        for index <- start..(start + length - 1), do: Batch.at(batch, index)
+      end}
+    end
+
+    def reduce(batch, acc, fun), do: reduce(batch, 0, acc, fun)
+
+    defp reduce(_batch, _index, {:halt, acc}, _fun), do: {:halted, acc}
+    defp reduce(batch, index, {:suspend, acc}, fun), do: {:suspended, acc, &reduce(batch, index, &1, fun)}
+    defp reduce(%Batch{size: size}, size, {:cont, acc}, _fun), do: {:done, acc}
+    defp reduce(batch, index, {:cont, acc}, fun), do: reduce(batch, index + 1, fun.(Batch.at(batch, index), acc), fun)
+  end
+end
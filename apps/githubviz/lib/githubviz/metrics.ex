@@ -13,21 +13,64 @@ defmodule GithubViz.Metrics do
 
   ### Gauges
 
-  Gauges are point-in-time scalar values.
+  Gauges are point-in-time scalar values. Samples are recorded into a
+  fixed-size histogram (see `GithubViz.Metrics.Histogram`) and summarized when
+  flushed.
 
   See `sample/2` and `time/3`.
+
+  ### Storage
+
+  Every metric is assigned a slot (or, for gauges, a contiguous block of slots)
+  in a single `:counters` array the first time it's used. Recording is a
+  registry lookup and a lock-free increment, so it's cheap enough to do on hot
+  paths. `GithubViz.Metrics.Flusher` periodically reports and resets
+  everything.
+
+  The array is sized up front for the number of counters and gauges we expect,
+  configured by `:counters` and `:gauges` under `:githubviz, :metrics`. Metrics
+  that don't fit, or that are used as both a counter and a gauge, are dropped
+  with a warning and counted by `metrics.dropped`.
   """
 
-  @type metric :: string
+  alias GithubViz.Metrics.Histogram
+
+  require Logger
+  alias Logger, as: L
 
-  @spec count(metric :: metric, value :: pos_integer) :: no_return
+  @registry __MODULE__
+  @storage {__MODULE__, :storage}
+
+  # Default number of metrics we make room for. Each counter takes a slot, and
+  # each gauge takes `Histogram.size/0`.
+  @counters 1_024
+  @gauges 64
+
+  @type metric :: String.t
+
+  @spec count(metric :: metric, value :: integer) :: :ok
   @doc "Increments or decrements a counter by `value`."
-  def count(_, 0) do end
-  def count(metric, value \\ 1) do end
+  def count(metric, value \\ 1)
+  def count(_, 0), do: :ok
+  def count(metric, value) do
+    with {counters, _} <- :persistent_term.get(@storage, nil),
+         slot when slot != nil <- slot(metric, :counter) do
+      :counters.add(counters, slot, value)
+    end
 
-  @spec sample(metric :: metric, value :: number) :: no_return
+    :ok
+  end
+
+  @spec sample(metric :: metric, value :: number) :: :ok
   @doc "Reports a sample `value`."
-  def sample(metric, value) do end
+  def sample(metric, value) do
+    with {counters, _} <- :persistent_term.get(@storage, nil),
+         slot when slot != nil <- slot(metric, :gauge) do
+      Histogram.record(counters, slot, value)
+    end
+
+    :ok
+  end
 
   @type resolution :: :second | :millisecond | :microsecond | :nanosecond
   @spec time(metric :: metric, options :: [{:resolution, resolution}], fun :: fun) :: any
@@ -36,23 +79,88 @@ defmodule GithubViz.Metrics do
 
   ## Options
 
-    * `:resolution` – what unit of time to report in. Can be `:second`,
+    * `:resolution` – what unit of time to report in. Can be `:second`,
       `:millisecond`, `:microsecond`, or `:nanosecond`.
       Defaults to `:millisecond`.
   """
   def time(metric, options \\ [], fun) do
     resolution = Keyword.get(options, :resolution, :millisecond)
 
-    start  = :erlang.monotonic_time(resolution)
-    result = nil
+    start = :erlang.monotonic_time(resolution)
 
     try do
-      result = fun.()
+      fun.()
     after
       duration = :erlang.monotonic_time(resolution) - start
       sample(metric, duration)
     end
+  end
+
+  @doc false
+  def init do
+    config = Application.get_env(:githubviz, :metrics, [])
+    slots = Keyword.get(config, :counters, @counters) +
+            Keyword.get(config, :gauges, @gauges) * Histogram.size()
+
+    :ets.new(@registry, [:set, :public, :named_table, read_concurrency: true])
+
+    counters = :counters.new(slots, [:write_concurrency])
+    allocated = :atomics.new(1, signed: false)
+
+    :persistent_term.put(@storage, {counters, allocated})
+
+    # Registered first, so we can always count what we drop.
+    slot("metrics.dropped", :counter)
+
+    :ok
+  end
+
+  @doc false
+  def registered do
+    case :persistent_term.get(@storage, nil) do
+      nil ->
+        {nil, []}
+      {counters, _} ->
+        # Skip whatever we've dropped.
+        spec = [{{:_, :_, :"$1"}, [{:is_integer, :"$1"}], [:"$_"]}]
+        {counters, :ets.select(@registry, spec)}
+    end
+  end
+
+  defp slot(metric, kind) do
+    case :ets.lookup(@registry, metric) do
+      [{_, ^kind, slot}] -> slot
+      [{_, other, _}] -> drop({metric, kind}, metric, kind, "already a #{other}")
+      [] -> register(metric, kind)
+    end
+  end
+
+  # Warns that we're dropping `metric` and counts it, but only the first time.
+  # We remember by registering `key` without a slot.
+  defp drop(key, metric, kind, reason) do
+    if :ets.insert_new(@registry, {key, kind, nil}) do
+      L.warn "Dropping #{kind} #{inspect metric}: #{reason}."
+      count("metrics.dropped")
+    end
+
+    nil
+  end
 
-    result
+  # Lock-free, so two processes may race to register the same metric. The
+  # loser's slots are wasted, but that only happens once per metric.
+  defp register(metric, kind) do
+    {counters, allocated} = :persistent_term.get(@storage)
+
+    size = if kind == :gauge, do: Histogram.size(), else: 1
+    last = :atomics.add_get(allocated, 1, size)
+
+    cond do
+      last > :counters.info(counters).size ->
+        drop(metric, metric, kind, "out of slots")
+      :ets.insert_new(@registry, {metric, kind, last - size + 1}) ->
+        last - size + 1
+      true ->
+        slot(metric, kind)
+    end
   end
 end
@@ -0,0 +1,144 @@
+defmodule GithubViz.Metrics.Flusher do
+  @moduledoc ~S"""
+  Periodically reports and resets every metric in statsd format.
+
+  Counters are reported as counts. Gauges are summarized as a count, mean,
+  minimum, median, 90th and 99th percentile, and maximum.
+
+  ## Configuration
+
+    * `:sink` – where to report to. Either `{:udp, host, port}` or
+      `{:file, path}`. Defaults to `{:udp, {127, 0, 0, 1}, 8125}`.
+    * `:interval` – how often (in milliseconds) we report.
+      Defaults to `10_000`.
+    * `:prefix` – prepended to every metric. Defaults to `""`.
+  """
+
+  use GenServer
+
+  alias GithubViz.Metrics
+  alias GithubViz.Metrics.Histogram
+
+  # Keep packets under a typical MTU.
+  @packet 1_400
+
+  defstruct [
+    sink: nil,
+    interval: 10_000,
+    prefix: ""
+  ]
+
+  def start_link do
+    GenServer.start_link(__MODULE__, [], name: __MODULE__)
+  end
+
+  def init([]) do
+    # So we get to flush whatever's left when we're shut down.
+    Process.flag(:trap_exit, true)
+
+    config = Application.get_env(:githubviz, :metrics, [])
+
+    sink = case Keyword.get(config, :sink, {:udp, {127, 0, 0, 1}, 8125}) do
+      {:udp, host, port} ->
+        {:ok, socket} = :gen_udp.open(0)
+        {:udp, socket, host, port}
+      {:file, path} ->
+        {:file, Path.expand(path)}
+    end
+
+    state = %__MODULE__{
+      sink: sink,
+      interval: Keyword.get(config, :interval, 10_000),
+      prefix: Keyword.get(config, :prefix, "")
+    }
+
+    Process.send_after(self(), :flush, state.interval)
+
+    {:ok, state}
+  end
+
+  def handle_info(:flush, state) do
+    flush(state)
+    Process.send_after(self(), :flush, state.interval)
+    {:noreply, state}
+  end
+
+  def handle_info({:EXIT, _, reason}, state) do
+    # Our socket went away.
+    {:stop, reason, state}
+  end
+
+  def terminate(_reason, state) do
+    flush(state)
+  end
+
+  defp flush(state) do
+    {counters, registered} = Metrics.registered()
+
+    lines = Enum.flat_map registered, fn {metric, kind, slot} ->
+      report(counters, kind, state.prefix <> metric, slot)
+    end
+
+    emit(state.sink, lines)
+  end
+
+  defp report(counters, :counter, metric, slot) do
+    case :counters.get(counters, slot) do
+      0 ->
+        []
+      count ->
+        :counters.sub(counters, slot, count)
+        ["#{metric}:#{count}|c"]
+    end
+  end
+
+  defp report(counters, :gauge, metric, slot) do
+    case Histogram.take(counters, slot) do
+      {[], _} ->
+        []
+      {counts, sum} ->
+        count = Enum.reduce(counts, 0, fn ({_, count}, total) -> total + count end)
+        {min, _} = List.first(counts)
+        {max, _} = List.last(counts)
+
+        ["#{metric}.count:#{count}|c",
+         "#{metric}.mean:#{div(sum, count)}|g",
+         "#{metric}.min:#{Histogram.lower(min)}|g",
+         "#{metric}.p50:#{Histogram.percentile(counts, 50)}|g",
+         "#{metric}.p90:#{Histogram.percentile(counts, 90)}|g",
+         "#{metric}.p99:#{Histogram.percentile(counts, 99)}|g",
+         "#{metric}.max:#{Histogram.lower(max)}|g"]
+    end
+  end
+
+  defp emit(_, []), do: :ok
+
+  defp emit({:udp, socket, host, port}, lines) do
+    for packet <- packets(lines) do
+      :gen_udp.send(socket, host, port, packet)
+    end
+
+    :ok
+  end
+
+  defp emit({:file, path}, lines) do
+    File.write(path, Enum.map(lines, &[&1, ?\n]), [:append])
+  end
+
+  # Packs newline-separated lines into packets of at most `@packet` bytes.
+  defp packets(lines) do
+    {packets, packet, _} =
+      Enum.reduce lines, {[], [], 0}, fn (line, {packets, packet, size}) ->
+        cond do
+          size == 0 ->
+            {packets, [line], byte_size(line)}
+          size + 1 + byte_size(line) > @packet ->
+            {[Enum.reverse(packet) |> Enum.intersperse(?\n) | packets], [line], byte_size(line)}
+          true ->
+            {packets, [line | packet], size + 1 + byte_size(line)}
+        end
+      end
+
+    Enum.reverse([Enum.reverse(packet) |> Enum.intersperse(?\n) | packets])
+  end
+end
@@ -0,0 +1,98 @@
+defmodule GithubViz.Metrics.Histogram do
+  @moduledoc ~S"""
+  A log-linear histogram stored in a contiguous block of `:counters` slots.
+
+  Values below 32 get a bucket each. Above that, every power of two is split
+  into 16 linear buckets, so any non-negative 64-bit integer lands in one of
+  `buckets/0` buckets with a relative error of at most 1/16. The block ends
+  with an extra slot holding the sum of every value recorded.
+  """
+
+  use Bitwise
+
+  @buckets 960
+
+  @doc "Number of buckets in a histogram."
+  def buckets, do: @buckets
+
+  @doc "Number of slots a histogram occupies."
+  def size, do: @buckets + 1
+
+  @doc "Records `value` in the histogram starting at `slot`."
+  def record(counters, slot, value) do
+    value = clamp(value)
+    :counters.add(counters, slot + bucket(value), 1)
+    :counters.add(counters, slot + @buckets, value)
+  end
+
+  @doc """
+  Reads and resets the histogram starting at `slot`.
+
+  Returns `{counts, sum}` where `counts` is a list of `{bucket, count}` for
+  every non-empty bucket, in ascending order.
+  """
+  def take(counters, slot) do
+    counts =
+      for bucket <- 0..(@buckets - 1),
+          count <- [:counters.get(counters, slot + bucket)],
+          count != 0 do
+        :counters.sub(counters, slot + bucket, count)
+        {bucket, count}
+      end
+
+    sum = :counters.get(counters, slot + @buckets)
+    :counters.sub(counters, slot + @buckets, sum)
+
+    {counts, sum}
+  end
+
+  @doc "Returns the bucket `value` falls in."
+  def bucket(value) when value < 32, do: value
+  def bucket(value) do
+    shift = msb(value) - 4
+    ((shift + 1) <<< 4) + ((value >>> shift) - 16)
+  end
+
+  @doc "Returns the smallest value that falls in `bucket`."
+  def lower(bucket) when bucket < 32, do: bucket
+  def lower(bucket) do
+    shift = (bucket >>> 4) - 1
+    ((bucket &&& 15) + 16) <<< shift
+  end
+
+  @doc """
+  Returns the value at `percentile` (0 to 100) from `counts` as returned by
+  `take/2`, or `nil` if empty.
+  """
+  def percentile([], _), do: nil
+  def percentile(counts, percentile) do
+    total = Enum.reduce(counts, 0, fn ({_, count}, total) -> total + count end)
+    rank = max(1, Float.ceil(total * percentile / 100) |> trunc)
+    percentile(counts, rank, 0)
+  end
+
+  defp percentile([{bucket, _}], _, _), do: lower(bucket)
+  defp percentile([{bucket, count} | rest], rank, seen) do
+    if seen + count >= rank do
+      lower(bucket)
+    else
+      percentile(rest, rank, seen + count)
+    end
+  end
+
+  # Histograms only hold non-negative integers that fit in a counter.
+  defp clamp(value) when is_float(value), do: clamp(round(value))
+  defp clamp(value) when value < 0, do: 0
+  defp clamp(value) when value > 0x7FFF_FFFF_FFFF_FFFF, do: 0x7FFF_FFFF_FFFF_FFFF
+  defp clamp(value), do: value
+
+  # Index of the most significant bit set in `value`.
+  defp msb(value), do: msb(value, 0)
+  defp msb(value, n) when value >= 0x1_0000_0000, do: msb(value >>> 32, n + 32)
+  defp msb(value, n) when value >= 0x1_0000, do: msb(value >>> 16, n + 16)
+  defp msb(value, n) when value >= 0x100, do: msb(value >>> 8, n + 8)
+  defp msb(value, n) when value >= 0x10, do: msb(value >>> 4, n + 4)
+  defp msb(value, n) when value >= 0x4, do: msb(value >>> 2, n + 2)
+  defp msb(value, n) when value >= 0x2, do: n + 1
+  defp msb(_, n), do: n
+end
@@ -7,6 +7,7 @@ defmodule GithubViz.Supervisor do
 
   def init(_options) do
     children = [
+      worker(GithubViz.Metrics.Flusher, [], restart: :permanent)
     ]
 
     supervise(children, strategy: :one_for_one)
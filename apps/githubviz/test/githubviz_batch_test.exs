@@ -0,0 +1,57 @@
+defmodule GithubViz.Github.Event.Batch.Test do
+  use ExUnit.Case, async: false
+
+  alias GithubViz.Github.Event
+  alias GithubViz.Github.Event.Batch
+  alias GithubViz.Github.Ref
+
+  test "pack and unpack" do
+    events = [event(1, :"code.pushes"), event(2, :"repos.forked"), event(3, :releases)]
+    batch = Batch.pack(events)
+
+    assert Batch.size(batch) == 3
+    assert Batch.ids(batch) == [1, 2, 3]
+    assert Batch.types(batch) == [:"code.pushes", :"repos.forked", :releases]
+    assert Batch.counts(batch) == [1, 1, 1]
+    assert Batch.total(batch) == 3
+    assert Batch.created_at(batch) == [1_500_000_001, 1_500_000_002, 1_500_000_003]
+    assert Batch.at(batch, 1) == Enum.at(events, 1)
+    assert Enum.to_list(batch) == events
+  end
+
+  test "weights" do
+    events = [event(1, :"code.pushes"), %Event{event(1, :"code.commits") | count: 300}]
+    batch = Batch.pack(events)
+
+    assert Batch.counts(batch) == [1, 300]
+    assert Batch.total(batch) == 301
+    assert Enum.to_list(batch) == events
+  end
+
+  test "unknown creation times" do
+    events = [%Event{event(1, :"code.pushes") | created_at: nil}]
+    batch = Batch.pack(events)
+
+    assert Batch.created_at(batch) == [nil]
+    assert Enum.to_list(batch) == events
+  end
+
+  test "take" do
+    events = [event(1, :"code.pushes"), event(2, :"repos.forked"), event(3, :releases)]
+    batch = Batch.pack(events)
+
+    assert Batch.take(batch, [true, true, true]) === batch
+    assert Batch.take(batch, [true, false, true]) |> Enum.to_list == [Enum.at(events, 0), Enum.at(events, 2)]
+    assert Batch.take(batch, [false, false, false]) |> Batch.size == 0
+  end
+
+  defp event(id, type) do
+    %Event{
+      id: id,
+      type: type,
+      created_at: 1_500_000_000 + id,
+      actor: %Ref{id: id * 10, url: "https://api.github.com/users/#{id}"},
+      repository: %Ref{id: id * 100, url: "https://api.github.com/repos/#{id}/#{id}"}
+    }
+  end
+end
@@ -73,6 +73,99 @@ defmodule GithubViz.Bitset.Test do
     :ok = GithubViz.Bitset.delete(bitset)
   end
 
+  test "planes" do
+    {:ok, bitset} = GithubViz.Bitset.open(temporary(), size: 3, planes: 2)
+
+    {:ok, [0, 0]} = GithubViz.Bitset.test_and_set(bitset, [{1, 0}, {2, 1}])
+    {:ok, [1, 0, 0, 1]} = GithubViz.Bitset.get(bitset, [{1, 0}, {1, 1}, {2, 0}, {2, 1}])
+    {:ok, [1, 0, 1]} = GithubViz.Bitset.test_and_set(bitset, [1, {1, 1}, {2, 1}])
+    {:ok, [1, 1]} = GithubViz.Bitset.get(bitset, [{1, 0}, {1, 1}])
+
+    :ok = GithubViz.Bitset.unset(bitset, [{1, 1}])
+    {:ok, [1, 0]} = GithubViz.Bitset.get(bitset, [{1, 0}, {1, 1}])
+
+    assert_raise ArgumentError, fn -> GithubViz.Bitset.get(bitset, [{1, 2}]) end
+
+    :ok = GithubViz.Bitset.delete(bitset)
+  end
+
+  test "read only" do
+    name = temporary()
+
+    {:error, :not_found} = GithubViz.Bitset.open(name, mode: :read_only)
+
+    {:ok, writer} = GithubViz.Bitset.open(name, size: 3)
+    {:error, :locked} = GithubViz.Bitset.open(name, size: 3)
+    {:ok, reader} = GithubViz.Bitset.open(name, mode: :read_only)
+
+    :ok = GithubViz.Bitset.set(writer, [1])
+    {:ok, [0, 1, 0]} = GithubViz.Bitset.get(reader, [0, 1, 2])
+    {:error, :permissions} = GithubViz.Bitset.set(reader, [2])
+
+    # Readers notice when the writer grows the bitset.
+    {:ok, [0]} = GithubViz.Bitset.get(reader, [1_000_000])
+    :ok = GithubViz.Bitset.set(writer, [1_000_000])
+    {:ok, [1]} = GithubViz.Bitset.get(reader, [1_000_000])
+
+    :ok = GithubViz.Bitset.close(reader)
+    :ok = GithubViz.Bitset.delete(writer)
+  end
+
+  test "closed handles" do
+    {:ok, bitset} = GithubViz.Bitset.open(temporary(), size: 3)
+    :ok = GithubViz.Bitset.delete(bitset)
+    assert_raise ArgumentError, fn -> GithubViz.Bitset.get(bitset, [0]) end
+    :ok = GithubViz.Bitset.close(bitset)
+  end
+
+  test "collected handles release their lock" do
+    name = temporary()
+
+    {pid, monitor} = spawn_monitor(fn -> {:ok, _} = GithubViz.Bitset.open(name, size: 3) end)
+    assert_receive {:DOWN, ^monitor, :process, ^pid, :normal}
+
+    # The handle is collected along with the process, but not necessarily by
+    # the time we hear about it.
+    {:ok, bitset} = Enum.find_value 1..100, fn _ ->
+      case GithubViz.Bitset.open(name) do
+        {:error, :locked} -> :timer.sleep(10); nil
+        opened -> opened
+      end
+    end
+
+    :ok = GithubViz.Bitset.delete(bitset)
+  end
+
+  test "ranges" do
+    {:ok, bitset} = GithubViz.Bitset.open(temporary(), size: 0)
+
+    :ok = GithubViz.Bitset.set_range(bitset, 3, 130)
+    {:ok, [0, 1, 1, 0]} = GithubViz.Bitset.get(bitset, [2, 3, 130, 131])
+    {:ok, <<0b00011111, 0b111::3>>} = GithubViz.Bitset.get_range(bitset, 0, 10)
+    {:ok, <<0b1100::4>>} = GithubViz.Bitset.get_range(bitset, 129, 132)
+
+    :ok = GithubViz.Bitset.unset_range(bitset, 4, 129)
+    {:ok, [1, 0, 0, 1]} = GithubViz.Bitset.get(bitset, [3, 4, 129, 130])
+
+    {:ok, packed} = GithubViz.Bitset.get_range(bitset, 0, 1_000_000)
+    assert bit_size(packed) == 1_000_001
+    assert (for <<state::1 <- packed>>, state == 1, do: 1) |> length == 2
+
+    assert_raise ArgumentError, fn -> GithubViz.Bitset.get_range(bitset, 2, 1) end
+
+    :ok = GithubViz.Bitset.delete(bitset)
+  end
+
+  test "ranges over planes" do
+    {:ok, bitset} = GithubViz.Bitset.open(temporary(), size: 0, planes: 2)
+
+    :ok = GithubViz.Bitset.set_range(bitset, 1, 2)
+    {:ok, [0, 0, 1, 1, 1, 1, 0, 0]} = GithubViz.Bitset.get(bitset, [{0, 0}, {0, 1}, {1, 0}, {1, 1}, {2, 0}, {2, 1}, {3, 0}, {3, 1}])
+    {:ok, <<0b00111100>>} = GithubViz.Bitset.get_range(bitset, 0, 3)
+
+    :ok = GithubViz.Bitset.delete(bitset)
+  end
+
   defp temporary do
     random = :crypto.strong_rand_bytes(20)
           |> Base.encode32(case: :lower)
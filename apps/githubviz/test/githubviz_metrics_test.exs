@@ -0,0 +1,62 @@
+defmodule GithubViz.Metrics.Test do
+  use ExUnit.Case, async: false
+
+  alias GithubViz.Metrics.Histogram
+
+  test "histogram buckets" do
+    for value <- Enum.concat(0..4_096, [0x7FFF_FFFF_FFFF_FFFF]) do
+      bucket = Histogram.bucket(value)
+      lower = Histogram.lower(bucket)
+      assert bucket < Histogram.buckets()
+      assert lower <= value
+      assert value - lower <= lower / 16
+    end
+  end
+
+  test "histogram percentiles" do
+    counters = :counters.new(Histogram.size(), [:write_concurrency])
+
+    for value <- 1..100, do: Histogram.record(counters, 1, value)
+
+    {counts, sum} = Histogram.take(counters, 1)
+    assert sum == 5_050
+    assert Histogram.percentile(counts, 50) == 50
+    assert Histogram.percentile(counts, 100) in 96..100
+
+    assert Histogram.take(counters, 1) == {[], 0}
+  end
+
+  test "counting" do
+    metric = "test.#{System.unique_integer([:positive])}"
+
+    # Otherwise it may report and reset our counter before we read it.
+    :ok = :sys.suspend(GithubViz.Metrics.Flusher)
+    on_exit fn -> :sys.resume(GithubViz.Metrics.Flusher) end
+
+    :ok = GithubViz.Metrics.count(metric, 2)
+    :ok = GithubViz.Metrics.count(metric)
+
+    {counters, registered} = GithubViz.Metrics.registered()
+    {_, :counter, slot} = List.keyfind(registered, metric, 0)
+    assert :counters.get(counters, slot) == 3
+  end
+
+  test "dropping" do
+    metric = "test.#{System.unique_integer([:positive])}"
+
+    :ok = :sys.suspend(GithubViz.Metrics.Flusher)
+    on_exit fn -> :sys.resume(GithubViz.Metrics.Flusher) end
+
+    {counters, registered} = GithubViz.Metrics.registered()
+    {_, :counter, dropped} = List.keyfind(registered, "metrics.dropped", 0)
+    before = :counters.get(counters, dropped)
+
+    # Counted once, no matter how many times it's dropped.
+    :ok = GithubViz.Metrics.count(metric)
+    :ok = GithubViz.Metrics.sample(metric, 1)
+    :ok = GithubViz.Metrics.sample(metric, 2)
+
+    assert :counters.get(counters, dropped) == before + 1
+    assert {_, :counter, _} = List.keyfind(elem(GithubViz.Metrics.registered(), 1), metric, 0)
+  end
+end
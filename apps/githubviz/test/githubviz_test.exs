@@ -1,3 +1,23 @@
 defmodule GithubViz.Test do
   use ExUnit.Case, async: false
+
+  alias GithubViz.Github.Event
+
+  test "pushes generate one weighted commits event" do
+    push = %{
+      "id" => "123",
+      "type" => "PushEvent",
+      "created_at" => "2017-03-01T12:00:00Z",
+      "actor" => %{"id" => 1, "url" => "https://api.github.com/users/octocat"},
+      "repo" => %{"id" => 2, "url" => "https://api.github.com/repos/octocat/hello"},
+      "payload" => %{"distinct_size" => 250}
+    }
+
+    [pushes, commits] = Event.Parser.parse(push)
+    assert %Event{id: 123, type: :"code.pushes", count: 1, created_at: 1_488_369_600} = pushes
+    assert %Event{id: 123, type: :"code.commits", count: 250} = commits
+
+    [%Event{type: :"code.pushes"}] =
+      Event.Parser.parse(put_in(push, ["payload", "distinct_size"], 0))
+  end
 end
@@ -1,23 +1,96 @@
 defmodule GithubViz.Stream.Broadcaster do
   @moduledoc ~S"""
-  Broadcasts events to all consumers.
+  Broadcasts batches of events to all consumers.
+
+  Batches are packed (see `GithubViz.Github.Event.Batch`), so broadcasting a
+  batch doesn't copy its events into every consumer.
+
+  Passive observers (see `observe/1`) are sent every batch directly rather
+  than subscribing, so they never create demand. When nobody is subscribed we
+  drain the deduplicator ourselves and hand batches to observers alone, rather
+  than stalling or buffering them for consumers that may never come.
   """
 
   use GenStage
 
-  defstruct []
+  # How many batches we ask the deduplicator for at a time.
+  @demand 100
+
+  defstruct [
+    # Processes observing every event we broadcast, keyed by monitor.
+    observers: %{},
 
-  def start_link do
-    GenStage.start_link(__MODULE__, [], name: __MODULE__)
+    # Consumers subscribed to us, by subscription reference.
+    consumers: MapSet.new
+  ]
+
+  def start_link(options \\ []) do
+    {name, options} = Keyword.pop(options, :name, __MODULE__)
+    GenStage.start_link(__MODULE__, options, name: name)
+  end
+
+  @spec observe(observer :: pid) :: :ok
+  @doc """
+  Sends `observer` every batch of events we broadcast as a
+  `{:observed, batches}` message, without creating any demand.
+  """
+  def observe(observer \\ self()) do
+    observe(__MODULE__, observer)
+  end
+
+  @spec observe(broadcaster :: GenStage.stage, observer :: pid) :: :ok
+  @doc false
+  def observe(broadcaster, observer) do
+    GenStage.call(broadcaster, {:observe, observer})
   end
 
   alias GithubViz.Metrics, as: M
 
-  def init([]) do
-    {:producer_consumer, %__MODULE__{}, subscribe_to: [GithubViz.Stream.Deduplicator], dispatcher: GenStage.BroadcastDispatcher}
+  def init(options) do
+    producers = Keyword.get(options, :subscribe_to, [GithubViz.Stream.Deduplicator])
+
+    {:producer_consumer, %__MODULE__{},
+     subscribe_to: Enum.map(producers, &{&1, max_demand: @demand}),
+     dispatcher: GenStage.BroadcastDispatcher}
+  end
+
+  def handle_subscribe(:producer, _options, from, state) do
+    # We ask for batches ourselves, so observers get them even when nobody's
+    # subscribed. See `handle_events/3`.
+    GenStage.ask(from, @demand)
+    {:manual, state}
+  end
+
+  def handle_subscribe(:consumer, _options, {_, ref}, state) do
+    {:automatic, %__MODULE__{state | consumers: MapSet.put(state.consumers, ref)}}
   end
 
-  def handle_events(events, _from, state) do
-    {:noreply, events, state}
+  def handle_cancel(_reason, {_, ref}, state) do
+    {:noreply, [], %__MODULE__{state | consumers: MapSet.delete(state.consumers, ref)}}
+  end
+
+  def handle_call({:observe, observer}, _from, state) do
+    monitor = Process.monitor(observer)
+    {:reply, :ok, [], %__MODULE__{state | observers: Map.put(state.observers, monitor, observer)}}
+  end
+
+  def handle_info({:DOWN, monitor, :process, _, _}, state) do
+    {:noreply, [], %__MODULE__{state | observers: Map.delete(state.observers, monitor)}}
+  end
+
+  def handle_events(batches, from, state) do
+    for {_, observer} <- state.observers do
+      send(observer, {:observed, batches})
+    end
+
+    # Asking for as many as we've handled is exactly what automatic demand
+    # would do, so consumers still hold us back when there are any.
+    GenStage.ask(from, length(batches))
+
+    if MapSet.size(state.consumers) == 0 do
+      {:noreply, [], state}
+    else
+      {:noreply, batches, state}
+    end
   end
 end
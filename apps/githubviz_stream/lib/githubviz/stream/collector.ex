@@ -1,6 +1,17 @@
 defmodule GithubViz.Stream.Collector do
   @moduledoc ~S"""
-  Periodically polls Github for new events.
+  Periodically polls Github for new events, producing them in packed batches.
+  See `GithubViz.Github.Event.Batch`.
+
+  Rather than fetching a fixed number of pages at a fixed interval, we adapt
+  to how much each poll overlaps with what we've already seen. The
+  `GithubViz.Stream.Deduplicator` tells us how many of the events we collected
+  were duplicates (see `overlap/2`) and before every poll we use that ratio:
+
+    * If nothing overlapped, we probably missed events between polls, so we
+      fetch deeper and poll sooner, but never sooner than Github allows.
+    * If most of it overlapped, we're wasting requests, so we fetch shallower
+      and back off.
   """
 
   use GenStage
@@ -8,76 +19,205 @@ defmodule GithubViz.Stream.Collector do
   # NOTE(mtwilliams): I've hardcoded these rather than parsing the `Link`
   # headers Github returns. While this isn't conforming to Github's guidelines,
   # it probably won't break. Fingers crossed.
-  @pages 3
   @events_per_page 100
 
+  # Github only ever serves the 300 most recent events.
+  @min_pages 1
+  @max_pages 3
+
+  # Ratio of duplicates at (or above) which we back off.
+  @high_overlap 0.5
+
+  # How far we'll back off, as a multiple of Github's interval.
+  @max_backoff 4
+
   defstruct [
-    # Amount of time (in seconds) we wait between requests. This varies at
-    # Github's behest, as our way of being respectful.
+    # Minimum amount of time (in seconds) we wait between requests. This varies
+    # at Github's behest, as our way of being respectful.
+    floor: 60,
+
+    # Amount of time (in seconds) we actually wait between polls. Adapts to
+    # overlap, but never dips below `floor`.
     interval: 60,
 
+    # Number of pages we fetch every poll.
+    pages: @max_pages,
+
+    # Pages currently being fetched, keyed by task reference.
+    fetching: %{},
+
+    # Number of duplicates and total number of events the deduplicator has
+    # seen from us since our last poll.
+    overlap: {0, 0},
+
     # Last seen entity tags for each page.
-    etags: %{}
+    etags: %{},
+
+    # Where we fetch events from. Anything that quacks like `GithubViz.Github`.
+    github: GithubViz.Github
   ]
 
-  def start_link do
-    GenStage.start_link(__MODULE__, [], name: __MODULE__)
+  def start_link(options \\ []) do
+    {name, options} = Keyword.pop(options, :name, __MODULE__)
+    GenStage.start_link(__MODULE__, options, name: name)
   end
 
-  def init([]) do
-    for page <- 1..@pages do
-      send(self(), {:fetch, page})
-    end
+  @spec overlap(collector :: GenStage.stage, duplicates :: non_neg_integer, total :: non_neg_integer) :: :ok
+  @doc """
+  Reports that `duplicates` out of `total` events we collected had already
+  been seen.
+  """
+  def overlap(collector \\ __MODULE__, duplicates, total) do
+    GenStage.cast(collector, {:overlap, duplicates, total})
+  end
 
-    {:producer, %__MODULE__{}}
+  def init(options) do
+    send(self(), :poll)
+    {:producer, %__MODULE__{github: Keyword.get(options, :github, GithubViz.Github)}}
   end
 
   alias GithubViz.Github
   alias GithubViz.Metrics, as: M
 
-  def handle_info({:fetch, page}, state) do
-    spawn fn ->
-      M.count("collector.polls", 1)
-      headers = %{"If-None-Match" => state.etags[page]}
-      parameters = %{page: page, per_page: @events_per_page}
-      {:ok, response} = Github.get("/events", headers, parameters)
-      send(__MODULE__, {:fetched, page, response})
+  require Logger
+  alias Logger, as: L
+
+  def handle_info(:poll, state) do
+    state = adapt(state)
+
+    M.count("collector.windows", 1)
+    M.sample("collector.pages", state.pages)
+
+    fetching = Map.new 1..state.pages, fn page ->
+      {github, etag} = {state.github, state.etags[page]}
+      task = Task.Supervisor.async_nolink(GithubViz.Stream.Collector.Tasks,
+                                          fn -> fetch(github, page, etag) end)
+      {task.ref, page}
     end
 
+    {:noreply, [], %__MODULE__{state | fetching: fetching}}
+  end
+
+  def handle_info({ref, result}, state) when is_reference(ref) do
+    Process.demonitor(ref, [:flush])
+
+    {page, fetching} = Map.pop(state.fetching, ref)
+    state = %__MODULE__{state | fetching: fetching}
+
+    case result do
+      {:ok, response} ->
+        fetched(page, response, state)
+      {:error, error} ->
+        L.warn "Failed to fetch page #{page} of events: #{inspect error}"
+        M.count("collector.failures", 1)
+        {:noreply, [], reschedule(state)}
+    end
+  end
+
+  def handle_info({:DOWN, ref, :process, _pid, reason}, state) do
+    {page, fetching} = Map.pop(state.fetching, ref)
+
+    L.warn "Crashed fetching page #{page} of events: #{inspect reason}"
+    M.count("collector.failures", 1)
+
+    {:noreply, [], reschedule(%__MODULE__{state | fetching: fetching})}
+  end
+
+  def handle_cast({:overlap, duplicates, total}, state) do
+    {seen, collected} = state.overlap
+    {:noreply, [], %__MODULE__{state | overlap: {seen + duplicates, collected + total}}}
+  end
+
+  def handle_demand(_demand, state) do
     {:noreply, [], state}
   end
 
-  def handle_info({:fetched, page, {status, headers, body} = response}, state) do
-    {interval, _} = Map.get(headers, "X-Poll-Interval", "60") |> Integer.parse
-    etag = Map.get(headers, "ETag")
+  defp fetch(github, page, etag) do
+    M.count("collector.polls", 1)
+    headers = if etag, do: %{"If-None-Match" => etag}, else: %{}
+    parameters = %{page: page, per_page: @events_per_page}
+    github.get("/events", headers, parameters)
+  end
+
+  defp fetched(page, {status, headers, _body} = response, state) do
+    {floor, _} = Map.get(headers, "X-Poll-Interval", "60") |> Integer.parse
+    etag = Map.get(headers, "ETag", state.etags[page])
 
     events = extract(response)
 
-    # TODO(mtwilliams): Try fetching quicker than the suggested interval? We
-    # might be missing events. Although it's not respectful, it isn't
-    # unprecedented...
+    M.count("events.collected", Enum.reduce(events, 0, &(&1.count + &2)))
 
-    # Nomially, we'll fetch the page again in 60 seconds.
-    Process.send_after(__MODULE__, {:fetch, page}, interval * 1_000)
+    # An unmodified page is as good as a page full of duplicates.
+    overlap = case status do
+      304 -> {@events_per_page, @events_per_page}
+      _ -> {0, 0}
+    end
 
-    M.sample("collector.time_between_polls", interval * 1_000)
-    M.count("events.collected", length(events))
+    batches = case events do
+      [] -> []
+      _ -> [Github.Event.Batch.pack(events)]
+    end
 
-    {:noreply, events, %__MODULE__{
-      state | interval: interval,
+    {:noreply, batches, reschedule(%__MODULE__{
+      state | floor: floor,
+              interval: max(state.interval, floor),
+              overlap: sum(state.overlap, overlap),
               etags: Map.put(state.etags, page, etag)
-    }}
+    })}
   end
 
-  def handle_demand(_demand, state) do
-    {:noreply, [], state}
+  # Schedules our next poll once every page of this one is in.
+  defp reschedule(%__MODULE__{fetching: fetching} = state) when fetching == %{} do
+    Process.send_after(self(), :poll, state.interval * 1_000)
+    M.sample("collector.time_between_polls", state.interval * 1_000)
+    state
   end
 
+  defp reschedule(state), do: state
+
+  # Nothing was collected, so we've nothing to go on.
+  defp adapt(%__MODULE__{overlap: {_, 0}} = state), do: state
+
+  defp adapt(%__MODULE__{overlap: {duplicates, total}} = state) do
+    M.sample("collector.overlap", round(100 * duplicates / total))
+
+    state = cond do
+      duplicates == 0 ->
+        # We've likely missed events.
+        M.count("collector.windows.unoverlapped", 1)
+        %__MODULE__{state | pages: min(state.pages + 1, @max_pages),
+                            interval: max(div(state.interval, 2), state.floor)}
+      duplicates / total >= @high_overlap ->
+        %__MODULE__{state | pages: max(state.pages - 1, @min_pages),
+                            interval: min(state.interval * 2, state.floor * @max_backoff)}
+      true ->
+        state
+    end
+
+    %__MODULE__{state | overlap: {0, 0}}
+  end
+
+  defp sum({a, b}, {c, d}), do: {a + c, b + d}
+
   defp extract({200, _, body}) do
-    body |> Poison.decode! |> Enum.flat_map(&Github.Event.Parser.parse/1)
+    raw = Poison.decode!(body)
+
+    # How long events took to reach us, not our consumers.
+    now = System.system_time(:seconds)
+    for %{"created_at" => created_at} <- raw,
+        {:ok, at, _} <- [DateTime.from_iso8601(created_at)] do
+      M.sample("collector.age", now - DateTime.to_unix(at))
+    end
+
+    Enum.flat_map(raw, &Github.Event.Parser.parse/1)
   end
 
   defp extract({304, _, _}) do
     []
   end
+
+  defp extract({status, _, _}) do
+    L.warn "Unexpected response (#{status}) when fetching events."
+    []
+  end
 end
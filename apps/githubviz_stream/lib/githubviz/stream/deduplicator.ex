@@ -5,6 +5,7 @@ defmodule GithubViz.Stream.Deduplicator do
 
   use GenStage
 
+  alias GithubViz.Github.Event.Batch
   alias GithubViz.Metrics, as: M
 
   # We use a simple bitset to check if we've seen an event before. This scales
@@ -12,6 +13,9 @@ defmodule GithubViz.Stream.Deduplicator do
   # unique identifiers. This has the added (and much needed) guarantee of
   # assuring we always identify duplicates, rather than identifying
   # duplicates for a small period time.
+  #
+  # Some events we generate are derived from the same event and thus share its
+  # identifier, so each kind of derived event gets its own plane.
   alias GithubViz.Stream.Deduplicator.Bitset
 
   defstruct []
@@ -25,19 +29,41 @@ defmodule GithubViz.Stream.Deduplicator do
     {:producer_consumer, %__MODULE__{}, subscribe_to: sources}
   end
 
-  # BUG(mtwilliams): Erroneously deduplicates `code.pushes` and `code.commits`
-  # messages as they share the same identifier.
-  def handle_events(events, _from, state) do
-    {:ok, seen_or_not} = Enum.map(events, &(&1.id))
+  def handle_events(batches, {producer, _}, state) do
+    {:ok, seen_or_not} = Enum.flat_map(batches, &bits/1)
                       |> Bitset.set
 
-    unseen = Enum.zip(events, seen_or_not)
-          |> Enum.filter_map(&(elem(&1, 1) == 0), &elem(&1, 0))
+    {unseen, []} = Enum.map_reduce batches, seen_or_not, fn (batch, seen_or_not) ->
+      {seen_or_not, rest} = Enum.split(seen_or_not, Batch.size(batch))
+      {Batch.take(batch, Enum.map(seen_or_not, &(&1 == 0))), rest}
+    end
+
+    total = Enum.reduce(batches, 0, &(Batch.size(&1) + &2))
+    duplicates = total - Enum.reduce(unseen, 0, &(Batch.size(&1) + &2))
 
-    M.count("events.duplicate", length(events) - length(unseen))
+    weight = Enum.reduce(batches, 0, &(Batch.total(&1) + &2))
+    M.count("events.duplicate", weight - Enum.reduce(unseen, 0, &(Batch.total(&1) + &2)))
+
+    # Let the collector know how much its polls overlap, so it can adapt. This
+    # is in records rather than weight, since that's what it pages through.
+    if producer == Process.whereis(GithubViz.Stream.Collector) do
+      GithubViz.Stream.Collector.overlap(duplicates, total)
+    end
+
+    unseen = Enum.reject(unseen, &(Batch.size(&1) == 0))
 
     {:noreply, unseen, state}
   end
+
+  defp bits(batch) do
+    Enum.zip(Batch.ids(batch), Enum.map(Batch.types(batch), &plane/1))
+  end
+
+  @doc false
+  def planes, do: 2
+
+  defp plane(:"code.commits"), do: 1
+  defp plane(_), do: 0
 end
 
 defmodule GithubViz.Stream.Deduplicator.Bitset do
@@ -80,14 +106,28 @@ defmodule GithubViz.Stream.Deduplicator.Bitset do
     {path, config} = Keyword.pop(config(), :path)
     path = Path.expand(path)
 
+    config = Keyword.put(config, :planes, GithubViz.Stream.Deduplicator.planes())
+
     L.info "Deduplicator bitset stored at `#{path}`..."
-    {:ok, bitset} = GithubViz.Bitset.open(path, config)
+    {:ok, bitset} = open(path, config)
 
     Process.flag(:trap_exit, true)
 
     {:ok, %__MODULE__{path: path, bitset: bitset}}
   end
 
+  defp open(path, config) do
+    case GithubViz.Bitset.open(path, config) do
+      {:error, :unsupported} ->
+        # Written by an older version or with a different number of planes.
+        L.warn "Moving incompatible deduplicator bitset to `#{path}.old`!"
+        :ok = File.rename(path, "#{path}.old")
+        GithubViz.Bitset.open(path, config)
+      result ->
+        result
+    end
+  end
+
   defp config do
     Application.get_env(:githubviz_stream, :deduplicator, [])
     |> Keyword.fetch!(:bitset)
@@ -99,14 +139,8 @@ defmodule GithubViz.Stream.Deduplicator.Bitset do
   end
 
   def handle_call({:set, bits}, _from, state) do
-    with {:ok, previous} <- GithubViz.Bitset.get(state.bitset, bits),
-         :ok <- GithubViz.Bitset.set(state.bitset, bits)
-    do
-      {:reply, {:ok, previous}, state}
-    else
-      result ->
-        {:reply, result, state}
-    end
+    result = GithubViz.Bitset.test_and_set(state.bitset, bits)
+    {:reply, result, state}
   end
 
   def terminate(:normal, state), do: flush(state.bitset)
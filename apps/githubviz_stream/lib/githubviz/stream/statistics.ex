@@ -1,37 +1,185 @@
 defmodule GithubViz.Stream.Statistics do
   @moduledoc ~S"""
   Reports metrics about our event stream.
+
+  We observe `GithubViz.Stream.Broadcaster` passively, so we never create
+  demand and never hold up the stream. Rolling counts are kept in
+  `GithubViz.Stream.Statistics.Store` for anyone to query.
   """
 
-  use GenStage
+  use GenServer
+
+  alias GithubViz.Github.Event.Batch
+  alias GithubViz.Stream.Broadcaster
+  alias GithubViz.Stream.Statistics.Store
 
   defstruct []
 
   def start_link do
-    GenStage.start_link(__MODULE__, [], name: __MODULE__)
+    GenServer.start_link(__MODULE__, [], name: __MODULE__)
   end
 
   alias GithubViz.Metrics, as: M
 
   def init([]) do
-    # TODO(mtwilliams): Allow subscriptions to `GithubViz.Stream.Broadcaster`
-    # that don't create demand, thereby allowing passive observers.
-    {:consumer, %__MODULE__{}, subscribe_to: [GithubViz.Stream.Broadcaster]}
+    send(self(), :observe)
+    {:ok, %__MODULE__{}}
+  end
+
+  def handle_info(:observe, state) do
+    case Process.whereis(Broadcaster) do
+      nil ->
+        # Try again once the broadcaster is (re)started.
+        Process.send_after(self(), :observe, 1_000)
+      broadcaster ->
+        Process.monitor(broadcaster)
+        :ok = Broadcaster.observe(self())
+    end
+
+    {:noreply, state}
+  end
+
+  def handle_info({:DOWN, _, :process, _, _}, state) do
+    send(self(), :observe)
+    {:noreply, state}
   end
 
-  def handle_events(events, _from, state) do
-    M.count("events.all", length(events))
+  def handle_info({:observed, batches}, state) do
+    now = System.system_time(:seconds)
+
+    for batch <- batches do
+      M.count("events.all", Batch.total(batch))
 
-    for {type, count} <- total(events) do
-      M.count("events.#{type}", count)
+      # From when it happened to when it was broadcast.
+      for created_at <- Batch.created_at(batch), created_at != nil do
+        M.sample("events.latency", now - created_at)
+      end
+
+      for {type, count} <- Enum.zip(Batch.types(batch), Batch.counts(batch)) do
+        M.count("events.#{type}", count)
+        Store.record(type, count)
+      end
     end
 
-    {:noreply, [], state}
+    {:noreply, state}
+  end
+end
+
+defmodule GithubViz.Stream.Statistics.Store do
+  @moduledoc ~S"""
+  Rolling per-type event counts, bucketed by second, minute, and hour.
+
+  Counts live in a public ETS table, so recording an event is a constant
+  number of counter updates and querying never touches the stream. Buckets
+  are keyed by absolute time and periodically swept once they fall out of
+  their window, so memory stays bounded.
+  """
+
+  use GenServer
+
+  @table __MODULE__
+
+  # How many buckets of each resolution we keep.
+  @seconds 60
+  @minutes 60
+  @hours 24
+
+  # How often (in milliseconds) we sweep stale buckets.
+  @sweep 15_000
+
+  @type window :: pos_integer
+
+  @spec record(type :: atom, count :: pos_integer) :: :ok
+  @doc "Counts `count` events of `type` as having happened now."
+  def record(type, count \\ 1) do
+    now = System.system_time(:seconds)
+
+    increment({:second, now, type}, count)
+    increment({:minute, div(now, 60), type}, count)
+    increment({:hour, div(now, 3_600), type}, count)
+
+    :ok
   end
 
-  defp total(events) do
-    Enum.reduce events, %{}, fn (event, totals) ->
-      Map.put(totals, event.type, Map.get(totals, event.type, 0) + 1)
+  defp increment(key, count) do
+    :ets.update_counter(@table, key, count, {key, 0})
+  end
+
+  @spec count(type :: atom, window :: window) :: non_neg_integer
+  @doc """
+  Returns the number of events of `type` over the last `window` seconds.
+
+  Windows are rounded up to the coarsest resolution needed to cover them, and
+  capped at a day.
+  """
+  def count(type, window) do
+    {resolution, from} = span(window)
+    spec = [{{{resolution, :"$1", type}, :"$2"}, [{:>=, :"$1", from}], [:"$2"]}]
+    :ets.select(@table, spec) |> Enum.sum
+  end
+
+  @spec counts(window :: window) :: %{atom => non_neg_integer}
+  @doc """
+  Returns the number of events of every type over the last `window` seconds.
+
+  See `count/2`.
+  """
+  def counts(window) do
+    {resolution, from} = span(window)
+    spec = [{{{resolution, :"$1", :"$2"}, :"$3"}, [{:>=, :"$1", from}], [{{:"$2", :"$3"}}]}]
+
+    Enum.reduce :ets.select(@table, spec), %{}, fn ({type, count}, counts) ->
+      Map.update(counts, type, count, &(&1 + count))
     end
   end
+
+  defp span(window) when window <= @seconds do
+    now = System.system_time(:seconds)
+    {:second, now - window + 1}
+  end
+
+  defp span(window) when window <= @minutes * 60 do
+    now = System.system_time(:seconds)
+    {:minute, div(now, 60) - div(window + 59, 60) + 1}
+  end
+
+  defp span(window) do
+    now = System.system_time(:seconds)
+    {:hour, div(now, 3_600) - div(min(window, @hours * 3_600) + 3_599, 3_600) + 1}
+  end
+
+  #
+  # Server
+  #
+
+  def start_link do
+    GenServer.start_link(__MODULE__, [], name: __MODULE__)
+  end
+
+  def init([]) do
+    :ets.new(@table, [:set, :public, :named_table,
+                      read_concurrency: true,
+                      write_concurrency: true])
+
+    Process.send_after(self(), :sweep, @sweep)
+
+    {:ok, nil}
+  end
+
+  def handle_info(:sweep, state) do
+    now = System.system_time(:seconds)
+
+    sweep(:second, now - @seconds)
+    sweep(:minute, div(now, 60) - @minutes)
+    sweep(:hour, div(now, 3_600) - @hours)
+
+    Process.send_after(self(), :sweep, @sweep)
+
+    {:noreply, state}
+  end
+
+  defp sweep(resolution, before) do
+    spec = [{{{resolution, :"$1", :_}, :_}, [{:<, :"$1", before}], [true]}]
+    :ets.select_delete(@table, spec)
+  end
 end
@@ -7,11 +7,13 @@ defmodule GithubViz.Stream.Supervisor do
 
   def init(_options) do
     children = [
+      supervisor(Task.Supervisor, [[name: GithubViz.Stream.Collector.Tasks]], restart: :permanent),
       worker(GithubViz.Stream.Collector, [], restart: :permanent),
       worker(GithubViz.Stream.Replayer, [], restart: :permanent),
       worker(GithubViz.Stream.Deduplicator.Bitset, [], restart: :permanent),
       worker(GithubViz.Stream.Deduplicator, [], restart: :permanent),
       worker(GithubViz.Stream.Broadcaster, [], restart: :permanent),
+      worker(GithubViz.Stream.Statistics.Store, [], restart: :permanent),
       worker(GithubViz.Stream.Statistics, [], restart: :permanent)
     ]
 
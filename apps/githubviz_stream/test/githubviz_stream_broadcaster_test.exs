@@ -0,0 +1,51 @@
+defmodule GithubViz.Stream.Broadcaster.Test do
+  use ExUnit.Case, async: false
+
+  alias GithubViz.Github.Event
+  alias GithubViz.Github.Event.Batch
+  alias GithubViz.Github.Ref
+  alias GithubViz.Stream.Broadcaster
+
+  defmodule Producer do
+    @moduledoc false
+
+    use GenStage
+
+    def init([]), do: {:producer, nil}
+
+    # Produces `batches` whether asked for or not.
+    def handle_cast({:produce, batches}, state), do: {:noreply, batches, state}
+
+    def handle_demand(_demand, state), do: {:noreply, [], state}
+  end
+
+  test "observers see every batch even when nobody is subscribed" do
+    {:ok, producer} = GenStage.start_link(Producer, [])
+    {:ok, broadcaster} = Broadcaster.start_link(name: nil, subscribe_to: [producer])
+
+    :ok = Broadcaster.observe(broadcaster, self())
+
+    # More than we ask for at a time, so we'd stall if nobody asked for more.
+    batches = for id <- 1..250, do: Batch.pack([event(id)])
+    GenStage.cast(producer, {:produce, batches})
+
+    assert observed(250) == batches
+  end
+
+  # Receives observed batches until there are `n` of them.
+  defp observed(n, seen \\ [])
+  defp observed(n, seen) when length(seen) >= n, do: seen
+  defp observed(n, seen) do
+    assert_receive {:observed, batches}
+    observed(n, seen ++ batches)
+  end
+
+  defp event(id) do
+    %Event{
+      id: id,
+      type: :"repos.forked",
+      actor: %Ref{id: id, url: "https://api.github.com/users/#{id}"},
+      repository: %Ref{id: id, url: "https://api.github.com/repos/#{id}/#{id}"}
+    }
+  end
+end
@@ -0,0 +1,133 @@
+defmodule GithubViz.Stream.Collector.Test do
+  use ExUnit.Case, async: false
+
+  alias GithubViz.Stream.Collector
+
+  defmodule Github do
+    @moduledoc false
+
+    # Hands every request to the test that's running, which decides how to
+    # respond. See `answer/2`.
+    def get("/events", headers, %{page: page}) do
+      test = Application.get_env(:githubviz_stream, __MODULE__)
+      send(test, {:fetch, self(), page, headers})
+
+      receive do
+        {:respond, response} -> {:ok, response}
+      after
+        5_000 -> {:error, :timeout}
+      end
+    end
+  end
+
+  setup do
+    Application.put_env(:githubviz_stream, Github, self())
+    {:ok, collector} = Collector.start_link(name: nil, github: Github)
+
+    # Our first poll happens as soon as we start.
+    state = answer(collector, &fresh/2)
+    assert {state.pages, state.interval} == {3, 60}
+
+    {:ok, collector: collector}
+  end
+
+  test "backs off when polls overlap", %{collector: collector} do
+    :ok = Collector.overlap(collector, 300, 300)
+    state = poll(collector, &fresh/2)
+    assert {state.pages, state.interval} == {2, 120}
+
+    :ok = Collector.overlap(collector, 150, 200)
+    state = poll(collector, &fresh/2)
+    assert {state.pages, state.interval} == {1, 120}
+
+    # No further than a page or four times Github's interval.
+    :ok = Collector.overlap(collector, 100, 100)
+    state = poll(collector, &fresh/2)
+    assert {state.pages, state.interval} == {1, 120}
+
+    # Some overlap is expected.
+    :ok = Collector.overlap(collector, 10, 100)
+    state = poll(collector, &fresh/2)
+    assert {state.pages, state.interval} == {1, 120}
+  end
+
+  test "fetches deeper and sooner when nothing overlaps", %{collector: collector} do
+    :ok = Collector.overlap(collector, 300, 300)
+    poll(collector, &fresh/2)
+    :ok = Collector.overlap(collector, 200, 200)
+    state = poll(collector, &fresh/2)
+    assert {state.pages, state.interval} == {1, 120}
+
+    :ok = Collector.overlap(collector, 0, 100)
+    state = poll(collector, &fresh/2)
+    assert {state.pages, state.interval} == {2, 60}
+
+    :ok = Collector.overlap(collector, 0, 200)
+    state = poll(collector, &fresh/2)
+    assert {state.pages, state.interval} == {3, 30}
+
+    # But never sooner than Github allows.
+    :ok = Collector.overlap(collector, 0, 300)
+    state = poll(collector, &fresh/2)
+    assert {state.pages, state.interval} == {3, 30}
+  end
+
+  test "unmodified pages count as overlap", %{collector: collector} do
+    # Nothing was collected, so there's nothing to adapt to.
+    state = poll(collector, &unmodified/2)
+    assert {state.pages, state.interval} == {3, 60}
+    assert state.overlap == {300, 300}
+
+    state = poll(collector, &unmodified/2)
+    assert {state.pages, state.interval} == {2, 120}
+  end
+
+  # Polls, answering every page with `respond`.
+  defp poll(collector, respond) do
+    send(collector, :poll)
+    answer(collector, respond)
+  end
+
+  # Answers every page of the poll in progress with `respond`, then waits for
+  # the collector to handle every response.
+  defp answer(collector, respond) do
+    for _ <- 1..state(collector).pages do
+      assert_receive {:fetch, fetcher, page, headers}
+      send(fetcher, {:respond, respond.(page, headers)})
+    end
+
+    settle(collector)
+  end
+
+  defp settle(collector) do
+    case state(collector) do
+      %Collector{fetching: fetching} = state when fetching == %{} ->
+        state
+      _ ->
+        :timer.sleep(10)
+        settle(collector)
+    end
+  end
+
+  defp state(collector) do
+    :sys.get_state(collector).state
+  end
+
+  defp fresh(page, _headers) do
+    events = for _ <- 1..100, do: event()
+    {200, %{"X-Poll-Interval" => "30", "ETag" => "\"#{page}\""}, Poison.encode!(events)}
+  end
+
+  defp unmodified(page, headers) do
+    assert headers["If-None-Match"] == "\"#{page}\""
+    {304, %{"X-Poll-Interval" => "30"}, ""}
+  end
+
+  defp event do
+    %{"id" => "#{System.unique_integer([:positive])}",
+      "type" => "ForkEvent",
+      "created_at" => DateTime.utc_now |> DateTime.to_iso8601,
+      "actor" => %{"id" => 1, "url" => "https://api.github.com/users/octocat"},
+      "repo" => %{"id" => 2, "url" => "https://api.github.com/repos/octocat/hello"}}
+  end
+end
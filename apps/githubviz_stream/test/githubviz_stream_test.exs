@@ -1,3 +1,21 @@
 defmodule GithubViz.Stream.Test do
   use ExUnit.Case, async: false
+
+  alias GithubViz.Stream.Statistics.Store
+
+  test "rolling counts" do
+    type = :"test.#{System.unique_integer([:positive])}"
+
+    assert Store.count(type, 60) == 0
+
+    :ok = Store.record(type)
+    :ok = Store.record(type, 2)
+
+    # Both may not land in the same second, but will within two.
+    assert Store.count(type, 2) == 3
+    assert Store.count(type, 60) == 3
+    assert Store.count(type, 3_600) == 3
+    assert Store.count(type, 86_400) == 3
+    assert Map.get(Store.counts(60), type) == 3
+  end
 end
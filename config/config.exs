@@ -6,6 +6,11 @@ config :logger,
   handle_otp_reports: false,
   handle_sasl_reports: false
 
+config :githubviz, :metrics,
+  sink: {:udp, {127, 0, 0, 1}, 8125},
+  interval: 10_000,
+  prefix: "githubviz."
+
 config :githubviz_stream, :deduplicator,
   bitset: [
     path: "duplicates.#{Mix.env}.bits",